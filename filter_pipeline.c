@@ -0,0 +1,516 @@
+/*
+    Program: median filter pipeline over many station files, see
+             filter_pipeline.h
+
+             A deque is a ring of tasks under its own lock: the owner
+             pushes and pops at the bottom, thieves take from the top.
+             The pool lock guards the station counters and the sleep of
+             idle threads: seq counts every push and every station done,
+             a thread that found no task sleeps only while seq has not
+             moved since it started looking, so no wake up is lost.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "filter_pipeline.h"
+#include "median_engine.h"
+#include "filter_sink.h"
+
+#define MANIFEST_LINE 1024
+
+enum pl_stage
+{
+    PL_READ,
+    PL_SORT,
+    PL_FILTER,
+    PL_WRITE
+};
+
+struct pl_task
+{
+    int station;
+    short stage;
+    short ch;                   // PL_FILTER: channel
+};
+
+struct pl_deque
+{
+    pthread_mutex_t lock;
+    struct pl_task *task;
+    long top, bottom;           // tasks top .. bottom-1, mod cap
+    int cap;
+};
+
+struct pl_pool
+{
+    const struct pipeline_opts *o;
+    struct pipeline_station *st;
+    int n;
+    int nt;
+    int depth;
+    struct pl_deque dq[PIPE_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    long seq;                   // pushes and stations done so far
+    int next;                   // next station to read
+    int inflight;
+    int done;
+    int sleeping;
+};
+
+struct pl_worker
+{
+    struct pl_pool *p;
+    int id;
+};
+
+/*
+Function: notify
+          a task was pushed or a station is done: wake the idle threads
+
+return: void
+*/
+static void notify(struct pl_pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->seq++;
+    if (p->sleeping > 0)
+        pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void pushTask(struct pl_pool *p, int w, int station, int stage, int ch) {
+    struct pl_deque *d = &p->dq[w];
+    pthread_mutex_lock(&d->lock);
+    struct pl_task *t = &d->task[d->bottom % d->cap];
+    t->station = station;
+    t->stage = (short)stage;
+    t->ch = (short)ch;
+    d->bottom++;
+    pthread_mutex_unlock(&d->lock);
+    notify(p);
+}
+
+static int popTask(struct pl_pool *p, int w, struct pl_task *t) {
+    struct pl_deque *d = &p->dq[w];
+    int got = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        d->bottom--;
+        *t = d->task[d->bottom % d->cap];
+        got = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return got;
+}
+
+/*
+Function: stealTask
+          the oldest task of the first other deque that has one
+
+return: int , 1 if a task was taken
+*/
+static int stealTask(struct pl_pool *p, int w, struct pl_task *t) {
+    for (int k = 1; k < p->nt; k++) {
+        struct pl_deque *d = &p->dq[(w + k) % p->nt];
+        int got = 0;
+        pthread_mutex_lock(&d->lock);
+        if (d->bottom > d->top) {
+            *t = d->task[d->top % d->cap];
+            d->top++;
+            got = 1;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (got)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+Function: admitStation
+          the read of the next station, if fewer than depth are in flight
+
+return: int , 1 if a station was admitted
+*/
+static int admitStation(struct pl_pool *p, struct pl_task *t) {
+    int got = 0;
+    pthread_mutex_lock(&p->lock);
+    if (p->next < p->n && p->inflight < p->depth) {
+        t->station = p->next++;
+        t->stage = PL_READ;
+        t->ch = 0;
+        p->inflight++;
+        got = 1;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return got;
+}
+
+/*
+Function: finishStation
+          release the series and buffers of a station, done or failed
+
+return: void
+*/
+static void finishStation(struct pl_pool *p, struct pipeline_station *s, int status) {
+    for (int c = 0; c < FLOAT_DATA; c++) {
+        free(s->ftr[c]);
+        s->ftr[c] = NULL;
+    }
+    temporalSeriesFree(&s->ts);
+    pthread_mutex_lock(&p->lock);
+    if (status != 0)
+        s->status = -1;
+    p->inflight--;
+    p->done++;
+    p->seq++;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/*
+Function: writeStation
+          the channels of a station to its sink, as median_filter does
+
+return: int , 0 on success, -1 if the output cannot be written
+*/
+static int writeStation(const struct pipeline_opts *o, struct pipeline_station *s) {
+    struct filter_sink sink;
+    int status;
+    if (strcmp(o->sink, "csv") == 0)
+        status = sinkOpenCsv(&sink, s->output);
+    else if (strcmp(o->sink, "bin") == 0)
+        status = sinkOpenBinary(&sink, s->output);
+    else
+        status = sinkOpenNone(&sink);
+    if (status != 0) {
+        fprintf(stderr, "cannot open output %s\n", s->output);
+        return -1;
+    }
+    for (int c = 0; status == 0 && c < o->ncols; c++) {
+        if (sinkWrite(&sink, o->names[c], s->ts.col[c], s->ftr[c], s->rows) != 0) {
+            fprintf(stderr, "cannot write %s to %s\n", o->names[c], s->output);
+            status = -1;
+        }
+    }
+    if (sinkClose(&sink) != 0)
+        status = -1;
+    return status;
+}
+
+/*
+Function: runTask
+          one stage of one station, pushing the tasks of the next stage
+          onto the deque of thread w
+
+return: void
+*/
+static void runTask(struct pl_pool *p, int w, const struct pl_task *t) {
+    const struct pipeline_opts *o = p->o;
+    struct pipeline_station *s = &p->st[t->station];
+
+    switch (t->stage) {
+    case PL_READ:
+        s->rows = temporalReadSeries(&s->ts, s->input, o->cols, o->ncols);
+        if (s->rows < 0) {
+            fprintf(stderr, "Cannot read file ");
+            perror(s->input);
+            finishStation(p, s, -1);
+            return;
+        }
+        pushTask(p, w, t->station, PL_SORT, 0);
+        break;
+
+    case PL_SORT:
+        if (temporalSeriesSort(&s->ts) != 0) {
+            fprintf(stderr, "%s: out of memory sorting %d rows\n", s->input, s->rows);
+            finishStation(p, s, -1);
+            return;
+        }
+        for (int c = 0; c < o->ncols; c++) {
+            s->ftr[c] = malloc((s->rows > 0 ? s->rows : 1) * sizeof(float));
+            if (!s->ftr[c]) {
+                fprintf(stderr, "%s: out of memory for %d rows\n", s->input, s->rows);
+                finishStation(p, s, -1);
+                return;
+            }
+        }
+        s->pending = o->ncols;
+        if (o->ncols == 0)
+            pushTask(p, w, t->station, PL_WRITE, 0);
+        for (int c = o->ncols - 1; c >= 0; c--)
+            pushTask(p, w, t->station, PL_FILTER, c);
+        break;
+
+    case PL_FILTER: {
+        int status = medianFilterWidth(s->ts.col[t->ch], s->ftr[t->ch], s->rows, o->width);
+        pthread_mutex_lock(&p->lock);
+        if (status != 0)
+            s->status = -1;
+        int last = (--s->pending == 0);
+        pthread_mutex_unlock(&p->lock);
+        if (last)
+            pushTask(p, w, t->station, PL_WRITE, 0);
+        break;
+    }
+
+    case PL_WRITE:
+        if (s->status != 0)
+            fprintf(stderr, "%s: median filter: out of memory\n", s->input);
+        finishStation(p, s, (s->status == 0) ? writeStation(o, s) : -1);
+        break;
+    }
+}
+
+static void *workerRun(void *arg) {
+    struct pl_worker *wk = arg;
+    struct pl_pool *p = wk->p;
+    struct pl_task t;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        long seq = p->seq;
+        int finished = (p->done == p->n);
+        pthread_mutex_unlock(&p->lock);
+        if (finished)
+            break;
+        if (popTask(p, wk->id, &t) || stealTask(p, wk->id, &t) || admitStation(p, &t)) {
+            runTask(p, wk->id, &t);
+            continue;
+        }
+        pthread_mutex_lock(&p->lock);
+        while (p->seq == seq && p->done < p->n) {
+            p->sleeping++;
+            pthread_cond_wait(&p->wake, &p->lock);
+            p->sleeping--;
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+static int nameCmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+Function: outputsClash
+          whether two stations would write the same output (inputs of the
+          same file name in different directories), reported on stderr
+
+return: int , 1 if any, 0 if every station has its own output
+*/
+static int outputsClash(struct pipeline_station st[], int n) {
+    const char **out = malloc((n > 0 ? n : 1) * sizeof(char *));
+    if (!out)
+        return 1;
+    int m = 0, clash = 0;
+    for (int i = 0; i < n; i++) {
+        if (st[i].output[0])
+            out[m++] = st[i].output;
+    }
+    qsort(out, m, sizeof(char *), nameCmp);
+    for (int i = 1; i < m; i++) {
+        if (strcmp(out[i - 1], out[i]) == 0 && (i == 1 || strcmp(out[i - 2], out[i]) != 0)) {
+            fprintf(stderr, "several inputs would write %s\n", out[i]);
+            clash = 1;
+        }
+    }
+    free(out);
+    return clash;
+}
+
+/*
+Function: pipelineRun
+          filter the n stations st[] (input set) on the pool, each
+          station's output named from its input in o->out_dir; the
+          outcome of each in its status and rows.  Nothing is run (all
+          fail) if two stations would write the same output or an
+          output name does not fit
+
+return: int , 0 if all stations were done, -1 if any failed, the outputs
+        clash or the pool cannot be set up
+*/
+int pipelineRun(const struct pipeline_opts *o, struct pipeline_station st[], int n) {
+    struct pl_pool p;
+    memset(&p, 0, sizeof(p));
+    p.o = o;
+    p.st = st;
+    p.n = n;
+    p.nt = o->nthreads;
+#ifndef _WIN32
+    if (p.nt <= 0)
+        p.nt = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (p.nt <= 0)
+        p.nt = 1;
+    if (p.nt > PIPE_MAX_THREADS)
+        p.nt = PIPE_MAX_THREADS;
+    p.depth = (o->depth > 0) ? o->depth : 2 * p.nt;
+
+    int clash = 0;
+    for (int i = 0; i < n; i++) {
+        struct pipeline_station *s = &st[i];
+        const char *base = s->input;
+        for (const char *q = s->input; *q; q++) {
+            if (*q == '/' || *q == '\\')
+                base = q + 1;
+        }
+        s->output[0] = '\0';
+        if ((strcmp(o->sink, "csv") == 0 || strcmp(o->sink, "bin") == 0)
+            && snprintf(s->output, sizeof(s->output), "%s/%s.%s", o->out_dir, base, o->sink)
+                   >= (int)sizeof(s->output)) {
+            fprintf(stderr, "output name of %s too long\n", s->input);
+            clash = 1;
+        }
+        s->rows = 0;
+        s->status = 0;
+        memset(s->ftr, 0, sizeof(s->ftr));
+        temporalSeriesInit(&s->ts, 0);
+    }
+    if (clash || outputsClash(st, n)) {
+        for (int i = 0; i < n; i++)
+            st[i].status = -1;
+        return -1;
+    }
+
+    // every task in flight fits in any one deque: a station holds at most
+    // ncols tasks at a time
+    int status = 0;
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.wake, NULL);
+    for (int w = 0; w < p.nt; w++) {
+        p.dq[w].cap = p.depth * (o->ncols > 0 ? o->ncols : 1) + 1;
+        p.dq[w].task = malloc(p.dq[w].cap * sizeof(struct pl_task));
+        pthread_mutex_init(&p.dq[w].lock, NULL);
+        if (!p.dq[w].task)
+            status = -1;
+    }
+
+    if (status == 0) {
+        struct pl_worker wk[PIPE_MAX_THREADS];
+        pthread_t th[PIPE_MAX_THREADS];
+        int started[PIPE_MAX_THREADS] = { 0 };
+        for (int w = 0; w < p.nt; w++) {
+            wk[w].p = &p;
+            wk[w].id = w;
+            started[w] = (w > 0 && pthread_create(&th[w], NULL, workerRun, &wk[w]) == 0);
+        }
+        workerRun(&wk[0]);          // the caller is thread 0, it steals from the others
+        for (int w = 1; w < p.nt; w++) {
+            if (started[w])
+                pthread_join(th[w], NULL);
+        }
+        for (int i = 0; i < n; i++) {
+            if (st[i].status != 0)
+                status = -1;
+        }
+    }
+
+    for (int w = 0; w < p.nt; w++) {
+        free(p.dq[w].task);
+        pthread_mutex_destroy(&p.dq[w].lock);
+    }
+    pthread_cond_destroy(&p.wake);
+    pthread_mutex_destroy(&p.lock);
+    return status;
+}
+
+/*
+Function: pipelineList
+          the input files of a directory (the regular files, not the
+          hidden ones, by name) or of a manifest (one path per line, blank
+          lines and '#' comments skipped)
+          inputs: allocated here, pipelineListFree
+
+return: int , number of inputs, -1 if path cannot be read or the list
+        does not fit in memory
+*/
+int pipelineList(const char *path, char ***inputs) {
+    struct stat sb;
+    int n = 0, cap = 0, ok = 1;
+    char **list = NULL;
+    *inputs = NULL;
+    if (stat(path, &sb) != 0)
+        return -1;
+
+    if (S_ISDIR(sb.st_mode)) {
+        DIR *dir = opendir(path);
+        if (!dir)
+            return -1;
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (de->d_name[0] == '.')
+                continue;
+            char name[FILE_NAME_LEN];
+            if (snprintf(name, sizeof(name), "%s/%s", path, de->d_name) >= (int)sizeof(name)
+                || stat(name, &sb) != 0 || !S_ISREG(sb.st_mode))
+                continue;
+            if (n == cap) {
+                cap = cap ? 2 * cap : 64;
+                char **l = realloc(list, cap * sizeof(char *));
+                if (!l) {
+                    ok = 0;
+                    break;
+                }
+                list = l;
+            }
+            if (!(list[n] = strdup(name))) {
+                ok = 0;
+                break;
+            }
+            n++;
+        }
+        closedir(dir);
+        if (ok)
+            qsort(list, n, sizeof(char *), nameCmp);
+    } else {
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            return -1;
+        char line[MANIFEST_LINE];
+        while (fgets(line, sizeof(line), fp)) {
+            char *s = line + strspn(line, " \t");
+            s[strcspn(s, "#\r\n")] = '\0';
+            for (size_t e = strlen(s); e > 0 && (s[e - 1] == ' ' || s[e - 1] == '\t'); e--)
+                s[e - 1] = '\0';
+            if (!*s)
+                continue;
+            if (n == cap) {
+                cap = cap ? 2 * cap : 64;
+                char **l = realloc(list, cap * sizeof(char *));
+                if (!l) {
+                    ok = 0;
+                    break;
+                }
+                list = l;
+            }
+            if (!(list[n] = strdup(s))) {
+                ok = 0;
+                break;
+            }
+            n++;
+        }
+        fclose(fp);
+    }
+    if (!ok) {
+        pipelineListFree(list, n);      // no run on part of the stations
+        return -1;
+    }
+    *inputs = list;
+    return n;
+}
+
+void pipelineListFree(char **inputs, int n) {
+    for (int i = 0; i < n; i++)
+        free(inputs[i]);
+    free(inputs);
+}
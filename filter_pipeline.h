@@ -0,0 +1,63 @@
+/*
+    Pipeline of the median filter over many station files at once.
+
+    Each station goes through four stages, each a task of its own:
+      read   : parse the file into a series (temporal_reader.c)
+      sort   : put the rows in time order
+      filter : one task per channel, the channels of a station in parallel
+      write  : the unfiltered and filtered channels to the station's sink
+    so the parsing and writing of some stations overlap the sorting and
+    filtering of others.
+
+    The tasks run on a pool of threads with work stealing: each thread
+    has a bounded deque, the tasks a stage makes for the same station go
+    on the bottom of its own deque and are taken from there first (the
+    series is still in its cache), a thread with nothing to do steals
+    from the top of another's deque.  A new station is read only when no
+    task is left, and at most depth stations are in flight, so the
+    memory holds depth series whatever the number of files.
+
+    Every station is filtered exactly as a run of median_filter on its
+    own, the outputs are the same bytes.  The outputs are named by the
+    input file name alone: inputs of one name in different directories
+    are refused before anything runs.
+*/
+
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include "temporal_reader.h"
+
+#define PIPE_MAX_THREADS 64
+#define PIPE_NAME_LEN 16        // channel name, as the sink names
+
+struct pipeline_opts
+{
+    int nthreads;               // <= 0: one per online CPU
+    int depth;                  // stations in flight, <= 0: 2 per thread
+    int width;                  // median window
+    const char *sink;           // "none", "csv" or "bin"
+    const char *out_dir;        // csv / bin: <out_dir>/<input file name>.<sink>
+    int ncols;
+    int cols[FLOAT_DATA];       // d[] columns, as median_filter
+    char names[FLOAT_DATA][PIPE_NAME_LEN];
+};
+
+// one input file and, after pipelineRun, its outcome
+struct pipeline_station
+{
+    const char *input;
+    char output[FILE_NAME_LEN];
+    int rows;
+    int status;                 // 0 done, -1 failed
+    // while in flight
+    struct temporal_series ts;
+    float *ftr[FLOAT_DATA];
+    int pending;                // channels still filtering
+};
+
+int pipelineList(const char *path, char ***inputs);
+void pipelineListFree(char **inputs, int n);
+int pipelineRun(const struct pipeline_opts *o, struct pipeline_station st[], int n);
+
+#endif
@@ -0,0 +1,263 @@
+/*
+    Program: output sinks for the median filter, see filter_sink.h
+
+             The gnuplot sink copies each channel into an (index, value)
+             float block and hands it to a thread, so the caller goes on
+             filtering while gnuplot reads the binary data from its pipe.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "filter_sink.h"
+
+#ifdef _WIN32
+#define PIPE_MODE "wb"          // binary data must not be translated
+#else
+#define PIPE_MODE "w"
+#endif
+
+struct plot_job
+{
+    char title[SINK_NAME_LEN];
+    int end;
+    float *xy;                  // [2][end][2]: unfiltered then filtered, (i, value) pairs
+};
+
+struct gnuplot_state
+{
+    int njobs;
+    pthread_t thread[SINK_MAX_PLOTS];
+};
+
+/*
+Function: plotThread
+          using gnu plot to plot the data to show the filtered portion over original
+          the data is sent inline in gnuplot's binary format, no text formatting
+
+return: void * , NULL
+*/
+static void *plotThread(void *arg) {
+    struct plot_job *job = arg;
+
+    FILE *gnuplot = popen("gnuplot -persistent", PIPE_MODE);
+    if (!gnuplot) {
+        perror("popen");
+        fprintf(stderr, " gnu launch error, %s not plotted\n", job->title);
+        free(job->xy);
+        free(job);
+        return NULL;
+    }
+    // default options used
+    fprintf(gnuplot, "set title '%s'\n", job->title);
+    fprintf(gnuplot, "plot '-' binary record=%d format='%%float%%float' u 1:2 t 'unfiltered' w lp lt 0, "
+                     "'-' binary record=%d format='%%float%%float' u 1:2 t 'filtered' w lines lt 2\n",
+            job->end, job->end);
+    fwrite(job->xy, sizeof(float), (size_t)4 * job->end, gnuplot);
+
+    fflush(gnuplot);
+    pclose(gnuplot);
+
+    free(job->xy);
+    free(job);
+    return NULL;
+}
+
+/*
+Function: gnuplotWrite
+          queue one channel for plotting, waits for the plots in flight
+          when SINK_MAX_PLOTS are already running
+
+return: int , 0 on success, -1 on failure
+*/
+static int gnuplotWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end) {
+    struct gnuplot_state *st = sink->state;
+
+    struct plot_job *job = malloc(sizeof(*job));
+    if (!job)
+        return -1;
+    job->xy = malloc((size_t)4 * (end > 0 ? end : 1) * sizeof(float));
+    if (!job->xy) {
+        free(job);
+        return -1;
+    }
+    job->title[0] = '\0';
+    strncat(job->title, name, SINK_NAME_LEN - 1);
+    job->end = end;
+    float *u = job->xy;
+    float *f = job->xy + 2 * end;
+    for (int i = 0; i < end; i++) {
+        u[2 * i] = (float)i; u[2 * i + 1] = dat[i];
+        f[2 * i] = (float)i; f[2 * i + 1] = ftr[i];
+    }
+
+    if (st->njobs == SINK_MAX_PLOTS) {
+        for (int k = 0; k < st->njobs; k++)
+            pthread_join(st->thread[k], NULL);
+        st->njobs = 0;
+    }
+    if (pthread_create(&st->thread[st->njobs], NULL, plotThread, job) != 0) {
+        plotThread(job);                                // no thread, plot in line
+        return 0;
+    }
+    st->njobs++;
+
+    return 0;
+}
+
+/*
+Function: gnuplotClose
+          wait for all plots to be sent
+
+return: int
+*/
+static int gnuplotClose(struct filter_sink *sink) {
+    struct gnuplot_state *st = sink->state;
+    for (int k = 0; k < st->njobs; k++)
+        pthread_join(st->thread[k], NULL);
+    free(st);
+    return 0;
+}
+
+/*
+Function: sinkOpenGnuplot
+
+return: int , 0 on success, -1 on allocation failure
+*/
+int sinkOpenGnuplot(struct filter_sink *sink) {
+    struct gnuplot_state *st = calloc(1, sizeof(*st));
+    if (!st)
+        return -1;
+    sink->kind = "gnuplot";
+    sink->write = gnuplotWrite;
+    sink->close = gnuplotClose;
+    sink->state = st;
+    return 0;
+}
+
+/*
+Function: csvWrite
+          channel,index,unfiltered,filtered per sample
+
+return: int , 0 on success, -1 on write error
+*/
+static int csvWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end) {
+    FILE *fp = sink->state;
+    for (int i = 0; i < end; i++)
+        fprintf(fp, "%s,%d,%g,%g\n", name, i, dat[i], ftr[i]);
+    return ferror(fp) ? -1 : 0;
+}
+
+/*
+Function: binaryWrite
+          one record per channel: name, count, unfiltered, filtered
+
+return: int , 0 on success, -1 on write error
+*/
+static int binaryWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end) {
+    FILE *fp = sink->state;
+    char rec_name[SINK_NAME_LEN] = { 0 };
+    strncat(rec_name, name, SINK_NAME_LEN - 1);
+    int32_t n = end;
+    fwrite(rec_name, 1, SINK_NAME_LEN, fp);
+    fwrite(&n, sizeof(n), 1, fp);
+    fwrite(dat, sizeof(float), (size_t)end, fp);
+    fwrite(ftr, sizeof(float), (size_t)end, fp);
+    return ferror(fp) ? -1 : 0;
+}
+
+/*
+Function: fileClose
+
+return: int , 0 on success, -1 if the file could not be completed
+*/
+static int fileClose(struct filter_sink *sink) {
+    return fclose(sink->state) == 0 ? 0 : -1;
+}
+
+/*
+Function: sinkOpenCsv, sinkOpenBinary
+
+return: int , 0 on success, -1 if the file cannot be created
+*/
+int sinkOpenCsv(struct filter_sink *sink, const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return -1;
+    fprintf(fp, "channel,index,unfiltered,filtered\n");
+    sink->kind = "csv";
+    sink->write = csvWrite;
+    sink->close = fileClose;
+    sink->state = fp;
+    return 0;
+}
+
+int sinkOpenBinary(struct filter_sink *sink, const char *filename) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+        return -1;
+    sink->kind = "bin";
+    sink->write = binaryWrite;
+    sink->close = fileClose;
+    sink->state = fp;
+    return 0;
+}
+
+/*
+Function: sinkOpenNone
+          discard the output, only the filtering is done
+
+return: int , 0
+*/
+static int noneWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end) {
+    (void)sink; (void)name; (void)dat; (void)ftr; (void)end;
+    return 0;
+}
+
+static int noneClose(struct filter_sink *sink) {
+    (void)sink;
+    return 0;
+}
+
+int sinkOpenNone(struct filter_sink *sink) {
+    sink->kind = "none";
+    sink->write = noneWrite;
+    sink->close = noneClose;
+    sink->state = NULL;
+    return 0;
+}
+
+/*
+Function: sinkOpen
+          open a sink from its name: gnuplot, none, csv:<file>, bin:<file>
+
+return: int , 0 on success, -1 on unknown name or failure to open
+*/
+int sinkOpen(struct filter_sink *sink, const char *spec) {
+    memset(sink, 0, sizeof(*sink));
+    if (strcmp(spec, "gnuplot") == 0)
+        return sinkOpenGnuplot(sink);
+    if (strcmp(spec, "none") == 0)
+        return sinkOpenNone(sink);
+    if (strncmp(spec, "csv:", 4) == 0 && spec[4])
+        return sinkOpenCsv(sink, spec + 4);
+    if (strncmp(spec, "bin:", 4) == 0 && spec[4])
+        return sinkOpenBinary(sink, spec + 4);
+    return -1;
+}
+
+/*
+Function: sinkWrite, sinkClose
+
+return: int , 0 on success, -1 on failure
+*/
+int sinkWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end) {
+    return sink->write(sink, name, dat, ftr, end);
+}
+
+int sinkClose(struct filter_sink *sink) {
+    return sink->close(sink);
+}
@@ -0,0 +1,40 @@
+/*
+    Output sinks for the median filter.
+
+    The filter only fills its output buffers, where they go is up to the
+    sink the caller opened:
+      gnuplot : plot of unfiltered against filtered, data sent to gnuplot
+                in its binary format from a background thread
+      csv     : text file, one row per sample: channel,index,unfiltered,filtered
+      bin     : raw binary file, per channel a record of
+                  char name[SINK_NAME_LEN]; int32 end;
+                  float unfiltered[end]; float filtered[end];
+      none    : nothing written, for batch runs
+
+    A sink is named on the command line as gnuplot, none, csv:<file>, bin:<file>
+*/
+
+#ifndef FILTER_SINK_H
+#define FILTER_SINK_H
+
+#define SINK_NAME_LEN 16        // channel name length in the binary record, includes null
+#define SINK_MAX_PLOTS 32       // gnuplot plots in flight at once
+
+struct filter_sink
+{
+    const char *kind;
+    int (*write)(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end);
+    int (*close)(struct filter_sink *sink);
+    void *state;
+};
+
+int sinkOpen(struct filter_sink *sink, const char *spec);
+int sinkOpenGnuplot(struct filter_sink *sink);
+int sinkOpenCsv(struct filter_sink *sink, const char *filename);
+int sinkOpenBinary(struct filter_sink *sink, const char *filename);
+int sinkOpenNone(struct filter_sink *sink);
+
+int sinkWrite(struct filter_sink *sink, const char *name, const float dat[], const float ftr[], int end);
+int sinkClose(struct filter_sink *sink);
+
+#endif
@@ -6,34 +6,28 @@ codes for the IRI algorithms.
 Data extracted from iritest.for are the electron density (Ne), m-3
 and converted to plasma frequency (MHz) then plotted using GNU PLOT.
 
-Several initial conditions (JF switch) have been defined but not used
-in the hopes of using a different interface, irisub.for.
+usage: assess1                          profile from the iritest.for dialog
+       assess1 heibeg heiend heistp     profile from IRI_SUB (iriProfile) for
+                                        the test case below, any number of
+                                        heights, e.g. assess1 60 2000 1
+       assess1 -s socket heibeg heiend heistp
+                                        the same profile from a running
+                                        iriserved (iriserve.h), no model
+                                        start up, at most OUTF_LEN heights
 
-Due to time limitations for lack of understanding the options used in iritest.for,
-the step size of the heights have been predetermined to be 54 using 
-    min: 60 m -absolute minimum in the algorithm
-    max: 600 m - from the sample plot
-    step: 10 m - random choice of value
+The arrays are sized from the height range, no height count is fixed here.
 
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-// const defn here instead of .h const style since very few constants
-#define JF_SWITCH 50
-#define OARR_SIZE 100
-#define OARR_LEN 1000
-#define OUTF_SIZE 20
-#define OUTF_LEN 1000
-#define TEMP_LOOP 54    // hardcoded loop count for the height step
-
-extern void iritest_(float [], float []);
-// used Unix style for boolean initial conditions
-typedef enum { 
-    B_FALSE, 
-    B_TRUE 
-} boolean_t;
+#include "iriengine.h"
+#include "iriserve.h"
+
+extern void iritest_(int *nhmax, float [], float [], int *nhei);
 
 /*
 assessgnu: use GNU PLOT to visualize data
@@ -41,18 +35,20 @@ assessgnu: use GNU PLOT to visualize data
 
 freq: 1-D array of plasma frequency values
 hgt: 1-D array of heights
+n: number of points
 return: 0
 */
-int assessgnu(float freq[], float hgt[]) {
+int assessgnu(float freq[], float hgt[], int n) {
 
     FILE *gnuplot = popen("gnuplot", "w");
     if (!gnuplot) {
         perror("popen");
         printf(" gnu launch error ");
+        return 0;
     }
     // default options used
     fprintf(gnuplot, "plot '-' u 1:2 t 'Frequency Mar 3, 2021:1100' w lp\n");
-    for (int i = 0; i < TEMP_LOOP; ++i) {
+    for (int i = 0; i < n; ++i) {
         fprintf(gnuplot,"%f %f\n", freq[i], hgt[i]);
     }
     fprintf(gnuplot, "e\n");
@@ -67,84 +63,113 @@ int assessgnu(float freq[], float hgt[]) {
 }
 
 /*
-To link with the IRI FORTRAN interface and extract the electron density per height.
-
-JF switches as initial conditions identified and set.  These have assumptions that
-were followed from iritest.for but not verified.  Not used with iritest.for but planned
-for use with irisub.for.
-
-External Function:
-assessgnu()
+assessirisub: electron density per height straight from IRI_SUB
+           the initial conditions are the iritest.for defaults (iriDefaultInput)
 
+sock: iriserved socket to run the profile, NULL for IRI_SUB in this process
+freq, hgt: filled with iriProfileHeights() values, allocated here, NULL
+           after a failure
+return: int , number of heights, -1 on failure
 */
-int main (void) {
-
-    // ICs declared as boolean
-    boolean_t compute_Ne = B_TRUE;
-    boolean_t compute_Te_Ti = B_TRUE;
-    boolean_t compute_Ni = B_TRUE;
-    boolean_t f107 = B_FALSE;
-    boolean_t f107a = B_FALSE;
-    boolean_t f1_layer = B_TRUE;
-    boolean_t bil2000 = B_FALSE;
-    boolean_t NmF2 = B_FALSE;
-    boolean_t hmF2 = B_FALSE;
-        
-    int jf[JF_SWITCH ];
-    for (int i=0; i<JF_SWITCH ; i++)
-        jf[i] = 1;
-
-    // set IC for JS switches
-    // taken from iritest.for listing of JF IC switches
-    // FORTRAN vs C index: change to 0-based for C, FORTRAN equivalent will be 1 step higher
-    jf[3] = 0;
-    jf[4] = 0;
-    jf[5] = 0;
-    jf[20] = 0;
-    jf[22] = 0;
-    jf[27] = 0;
-    jf[28] = 0;
-    jf[29] = 0;
-    jf[32] = 0;
-    jf[34] = 0;
-    jf[38] = 0;
-    jf[39] = 0;
-    jf[46] = 0;
-
-    // output array
-    float oarr[OARR_LEN][OARR_SIZE];
-    for (int j=0; j<OARR_LEN ; j++)
-        for (int i=0; i<OARR_SIZE ; i++)
-            oarr[j][i] = 0.0;
-
-    float outf[OUTF_LEN][OUTF_SIZE];
+int assessirisub(const char *sock, float heibeg, float heiend, float heistp, float **freq, float **hgt) {
 
     // required input parameters
     // these are hard coded due to time, this assessment has been on trial for awhile
     // so deliberately setting the values as is to compare
     // against the test case ran versus iritest.for
     // description taken from irisub.for
-    int jmag = 0;           // geographic
-    float alati = 50.;      // LATITUDE NORTH AND LONGITUDE EAST IN DEGREES
-    float along = 40.;
-    float iyyyy = 2000.;
-    float mmdd = 0101;      // data
-    float dhour = 1.5;      // in UT, LOCAL TIME (OR UNIVERSAL TIME + 25) IN DECIMAL HOURS
-                            // hard coded as Time_type = Universal
-    float heibeg = 100.;        // HEIGHT RANGE IN KM; maximal 100 heights
-    float heiend = 2000.;
-    float heistp = 50.;
-
-    printf("\nProducing results from iritest.for\n\n");
-    // link to the FORTRAN interface
-    float freq[TEMP_LOOP]; float hgt[TEMP_LOOP];
-    iritest_(freq, hgt);
-
-    for ( int i=0; i<TEMP_LOOP; i++) {
+    struct iri_input in;
+    iriDefaultInput(&in);
+    in.jmag = 0;            // geographic
+    in.alati = 50.;         // LATITUDE NORTH AND LONGITUDE EAST IN DEGREES
+    in.along = 40.;
+    in.iyyyy = 2000;
+    in.mmdd = 101;          // date
+    in.dhour = 1.5;         // LOCAL TIME (OR UNIVERSAL TIME + 25) IN DECIMAL HOURS
+    in.heibeg = heibeg;     // HEIGHT RANGE IN KM
+    in.heiend = heiend;
+    in.heistp = heistp;
+    iriWantOutputs(&in, IRI_WANT_NE);   // only Ne is plotted
+    *freq = *hgt = NULL;
+    int nhmax = iriProfileHeights(&in);
+    if (heistp == 0.f || nhmax < 1)
+        return -1;
+
+    float (*outf)[OUTF_SIZE] = malloc((size_t)nhmax * sizeof(*outf));
+    float oarr[OARR_SIZE];
+    *freq = malloc(nhmax * sizeof(float));
+    *hgt = malloc(nhmax * sizeof(float));
+    int n = -1;
+    if (outf && *freq && *hgt) {
+        if (sock) {
+            int fd = iriServeConnect(sock);
+            n = (fd >= 0) ? iriServeProfile(fd, &in, nhmax, outf, oarr) : -1;
+            iriServeClose(fd);
+        } else {
+            n = iriProfile(&in, nhmax, outf, oarr);
+        }
+    }
+    if (n < 0) {
+        free(outf);
+        free(*freq);
+        free(*hgt);
+        *freq = *hgt = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        (*freq)[i] = outf[i][0] / 1.e6f;        // as jne in iritest.for
+        (*hgt)[i] = heibeg + i * heistp;
+    }
+    free(outf);
+    return n;
+}
+
+/*
+To link with the IRI FORTRAN interface and extract the electron density per height.
+
+External Function:
+assessgnu()
+
+*/
+int main (int argc, char *argv[]) {
+
+    float *freq = NULL, *hgt = NULL;
+    int n;
+
+    if (argc == 4) {
+        printf("\nProducing results from irisub.for\n\n");
+        n = assessirisub(NULL, atof(argv[1]), atof(argv[2]), atof(argv[3]), &freq, &hgt);
+    } else if (argc == 6 && strcmp(argv[1], "-s") == 0) {
+        printf("\nProducing results from iriserved on %s\n\n", argv[2]);
+        n = assessirisub(argv[2], atof(argv[3]), atof(argv[4]), atof(argv[5]), &freq, &hgt);
+    } else if (argc == 1) {
+        printf("\nProducing results from iritest.for\n\n");
+        // link to the FORTRAN interface, iri_web computes at most OUTF_LEN steps
+        int nhmax = OUTF_LEN;
+        freq = malloc(nhmax * sizeof(float));
+        hgt = malloc(nhmax * sizeof(float));
+        n = -1;
+        if (freq && hgt)
+            iritest_(&nhmax, freq, hgt, &n);
+    } else {
+        fprintf(stderr, "usage: assess1 [[-s socket] heibeg heiend heistp]\n");
+        return 1;
+    }
+    if (n < 0) {
+        fprintf(stderr, "assess1: no profile\n");
+        free(freq);
+        free(hgt);
+        return 1;
+    }
+
+    for ( int i=0; i<n; i++) {
         freq[i] = sqrt(freq[i]*8.0640e-5*1.0e6f)/1.0e6f;
     }
 
-    assessgnu(freq, hgt);
+    assessgnu(freq, hgt, n);
 
+    free(freq);
+    free(hgt);
     return 0;
-}
\ No newline at end of file
+}
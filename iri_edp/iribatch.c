@@ -0,0 +1,281 @@
+/*
+iribatch: runs a job file of IRI_SUB profiles without any prompt and
+streams the results out, the batch counterpart of the iritest.for dialog.
+
+The model is initialized once (index files, CCIR/URSI and IGRF
+coefficients, see iriEngineInit), the jobs are then run in chunks on the
+worker pool of iriengine.c and each chunk is written out as it is done.
+
+usage: iribatch [-w workers] [-c chunk] [-o text|bin] [-p trace|-] [-C dir] <job file>
+       job file "-" reads the jobs from stdin
+       -C  result cache in directory dir (iricache.h): profiles run before,
+           with the same index and coefficient files, are not run again
+       -p  stage timings of the run on stderr (iriprof.h, a build with
+           PROF=-DIRI_PROF), and a Chrome trace into the file trace;
+           use -w 1, the workers keep their own counts
+
+Job file, text: one profile per line, '#' starts a comment (a job per
+  line rather than a JSON document: the jobs stream in without a parser
+  and the fields are the IRI_SUB argument list, in its order)
+    jmag lati long yyyy mmdd dhour heibeg heiend heistp [jfN=0|1 ...] [oarrN=value ...]
+        [want=ne|peaks|tec|full]
+  as the IRI_SUB arguments (dhour: local time, or UT + 25), any jf switch
+  (FORTRAN index 1-50) changed from the iritest.for defaults, and OARR
+  input values for the switches set to user input.  JF(34), the program
+  messages on unit 6, is off unless set: they would go into the results.
+  want= skips the sub-models the outputs do not need (iriWantOutputs),
+  after the jf settings of the line.
+Job file, binary: JOB_MAGIC, int32 count, then count struct iri_input
+
+Output, text: per job a header line with OARR(1:6), then one line per
+  height with the height and OUTF(1:11) (Ne, Tn, Ti, Te, ion densities)
+Output, bin: per job int32 job, int32 heights, float OARR(100),
+  float OUTF(20, heights)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "iriengine.h"
+#include "iriprof.h"
+#include "iricache.h"
+
+#define JOB_MAGIC "IRIJOB1"     // 8 bytes with the null
+#define JOB_LINE 1024           // longest job line
+#define JOB_CHUNK 64            // jobs per worker in a chunk
+#define TRACE_EVENTS (1L << 22) // trace events kept with -p
+
+struct job_file
+{
+    FILE *fp;
+    int binary;
+    int32_t left;               // binary: jobs still to read
+    long line;                  // text: line number
+    long skipped;
+};
+
+/*
+jobOpen: open the job file and tell its kind from the first bytes
+
+return: int , 0 on success, -1 on failure
+*/
+static int jobOpen(struct job_file *jf, const char *filename) {
+    memset(jf, 0, sizeof(*jf));
+    jf->fp = (strcmp(filename, "-") == 0) ? stdin : fopen(filename, "rb");
+    if (!jf->fp)
+        return -1;
+
+    char magic[sizeof(JOB_MAGIC)];
+    int c = getc(jf->fp);
+    if (c == JOB_MAGIC[0]) {
+        magic[0] = (char)c;
+        if (fread(magic + 1, 1, sizeof(magic) - 1, jf->fp) != sizeof(magic) - 1
+            || memcmp(magic, JOB_MAGIC, sizeof(magic)) != 0
+            || fread(&jf->left, sizeof(jf->left), 1, jf->fp) != 1) {
+            fprintf(stderr, "%s: bad binary job file\n", filename);
+            return -1;
+        }
+        jf->binary = 1;
+    } else if (c != EOF) {
+        ungetc(c, jf->fp);
+    }
+    return 0;
+}
+
+/*
+parseJob: one text job line into in (defaults already set)
+
+return: int , 1 job read, 0 blank or comment line, -1 malformed
+*/
+static int parseJob(char *line, struct iri_input *in) {
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = '\0';
+
+    int used = 0;
+    int n = sscanf(line, "%d %f %f %d %d %f %f %f %f %n", &in->jmag, &in->alati, &in->along,
+                   &in->iyyyy, &in->mmdd, &in->dhour, &in->heibeg, &in->heiend, &in->heistp, &used);
+    if (n == EOF || (n <= 0 && strspn(line, " \t\r\n") == strlen(line)))
+        return 0;
+    if (n != 9 || in->heistp == 0.f)
+        return -1;
+
+    static const char *wants[] = { "want=full", "want=ne", "want=peaks", "want=tec" };
+    int want = IRI_WANT_FULL;
+    for (char *tok = strtok(line + used, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+        int k, on;
+        float val;
+        if (sscanf(tok, "jf%d=%d", &k, &on) == 2 && k >= 1 && k <= JF_SWITCH)
+            iriSetSwitch(in, k, on);
+        else if (sscanf(tok, "oarr%d=%f", &k, &val) == 2 && k >= 1 && k <= OARR_SIZE)
+            in->oarr[k - 1] = val;
+        else if (strncmp(tok, "want=", 5) == 0) {
+            for (k = 0; k < 4 && strcmp(tok, wants[k]) != 0; k++)
+                ;
+            if (k == 4)
+                return -1;
+            want = k;
+        } else
+            return -1;
+    }
+    iriWantOutputs(in, want);
+    return 1;
+}
+
+/*
+jobRead: up to max jobs, malformed text lines are skipped with a message
+
+return: int , jobs read, 0 at the end of the file
+*/
+static int jobRead(struct job_file *jf, struct iri_input in[], int max) {
+    int n = 0;
+    if (jf->binary) {
+        if (max > jf->left)
+            max = jf->left;
+        n = (int)fread(in, sizeof(struct iri_input), max, jf->fp);
+        jf->left = (n == max) ? jf->left - n : 0;
+        return n;
+    }
+
+    char line[JOB_LINE];
+    while (n < max && fgets(line, sizeof(line), jf->fp)) {
+        jf->line++;
+        iriDefaultInput(&in[n]);
+        in[n].jf[33] = 0;               // JF(34) messages off, unit 6 is the result stream
+        int r = parseJob(line, &in[n]);
+        if (r < 0) {
+            fprintf(stderr, "job line %ld skipped: %s", jf->line, line);
+            jf->skipped++;
+        }
+        if (r > 0)
+            n++;
+    }
+    return n;
+}
+
+/*
+writeText, writeBinary: results of jobs first .. first+n-1
+
+return: int , 0 on success, -1 on write error
+*/
+static int writeText(FILE *fp, long first, const struct iri_input in[], const struct iri_result out[], int n) {
+    for (int k = 0; k < n; k++) {
+        const float *oa = out[k].oarr;
+        fprintf(fp, "# job %ld jmag %d lat %.2f lon %.2f date %d %04d hour %.2f"
+                    " NmF2 %.4e hmF2 %.1f NmF1 %.4e hmF1 %.1f NmE %.4e hmE %.1f\n",
+                first + k, in[k].jmag, in[k].alati, in[k].along, in[k].iyyyy, in[k].mmdd, in[k].dhour,
+                oa[0], oa[1], oa[2], oa[3], oa[4], oa[5]);
+        int nh = iriHeights(&in[k]);
+        for (int i = 0; i < nh; i++) {
+            const float *o = out[k].outf[i];
+            fprintf(fp, "%.1f %.4e %.1f %.1f %.1f %.3f %.3f %.3f %.3f %.3f %.3f %.3f\n",
+                    in[k].heibeg + i * in[k].heistp,
+                    o[0], o[1], o[2], o[3], o[4], o[5], o[6], o[7], o[8], o[9], o[10]);
+        }
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+static int writeBinary(FILE *fp, long first, const struct iri_input in[], const struct iri_result out[], int n) {
+    for (int k = 0; k < n; k++) {
+        int32_t head[2] = { (int32_t)(first + k), iriHeights(&in[k]) };
+        fwrite(head, sizeof(head), 1, fp);
+        fwrite(out[k].oarr, sizeof(float), OARR_SIZE, fp);
+        fwrite(out[k].outf, sizeof(float) * OUTF_SIZE, head[1], fp);
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    int nworkers = 0, chunk = 0, binary = 0;
+    const char *prof = NULL, *cache_dir = NULL;
+    int a = 1;
+    for (; a + 1 < argc && argv[a][0] == '-' && argv[a][1]; a += 2) {
+        if (strcmp(argv[a], "-w") == 0)
+            nworkers = atoi(argv[a + 1]);
+        else if (strcmp(argv[a], "-c") == 0)
+            chunk = atoi(argv[a + 1]);
+        else if (strcmp(argv[a], "-o") == 0 && strcmp(argv[a + 1], "text") == 0)
+            binary = 0;
+        else if (strcmp(argv[a], "-o") == 0 && strcmp(argv[a + 1], "bin") == 0)
+            binary = 1;
+        else if (strcmp(argv[a], "-p") == 0)
+            prof = argv[a + 1];
+        else if (strcmp(argv[a], "-C") == 0)
+            cache_dir = argv[a + 1];
+        else
+            break;
+    }
+    if (a + 1 != argc) {
+        fprintf(stderr, "usage: iribatch [-w workers] [-c chunk] [-o text|bin] [-p trace|-] [-C dir] <job file>\n");
+        return 1;
+    }
+
+    struct job_file jf;
+    if (jobOpen(&jf, argv[a]) != 0) {
+        fprintf(stderr, "iribatch: cannot open %s\n", argv[a]);
+        return 1;
+    }
+
+    if (prof) {                 // from before the init, so its file reads count
+        iriProfReset();
+        if (strcmp(prof, "-") != 0 && iriProfTrace(TRACE_EVENTS) != 0)
+            fprintf(stderr, "iribatch: no memory for the trace\n");
+    }
+
+    struct iri_engine eng;
+    if (iriEngineInit(&eng, nworkers) != 0)
+        return 1;
+    if (chunk <= 0)
+        chunk = JOB_CHUNK * eng.nworkers;
+    struct iri_cache cache;
+    if (cache_dir) {
+        if (iriCacheOpen(&cache, cache_dir) != 0) {
+            fprintf(stderr, "iribatch: cannot use %s as the result cache\n", cache_dir);
+            return 1;
+        }
+        eng.cache = &cache;
+    }
+
+    struct iri_input *in = malloc(chunk * sizeof(struct iri_input));
+    struct iri_result *out = malloc(chunk * sizeof(struct iri_result));
+    if (!in || !out) {
+        fprintf(stderr, "iribatch: out of memory for %d jobs\n", chunk);
+        return 1;
+    }
+
+    int status = 0;
+    long done = 0;
+    int n;
+    while (status == 0 && (n = jobRead(&jf, in, chunk)) > 0) {
+        if (iriEngineRun(&eng, in, out, n) != 0) {
+            fprintf(stderr, "iribatch: jobs %ld to %ld not run\n", done, done + n - 1);
+            status = 1;
+            break;
+        }
+        if ((binary ? writeBinary : writeText)(stdout, done, in, out, n) != 0)
+            status = 1;
+        done += n;
+    }
+    fflush(stdout);
+    fprintf(stderr, "iribatch: %ld jobs, %ld lines skipped\n", done, jf.skipped);
+    if (cache_dir)
+        fprintf(stderr, "iribatch: cache %ld hits, %ld misses, %ld stored\n", cache.hits, cache.misses,
+                cache.stores);
+    if (prof) {
+        iriProfWrite(stderr);
+        if (strcmp(prof, "-") != 0 && iriProfTraceWrite(prof) != 0)
+            fprintf(stderr, "iribatch: cannot write %s\n", prof);
+    }
+
+    iriEngineClose(&eng);
+    free(in);
+    free(out);
+    if (jf.fp != stdin)
+        fclose(jf.fp);
+
+    return status;
+}
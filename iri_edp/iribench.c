@@ -0,0 +1,288 @@
+/*
+iribench: timings of IRI_SUB and IRI_WEB on fixed inputs, so runs can be
+compared between builds and releases.
+
+The cases, in this order (one process, so the order matters):
+  cold   the first profile of the process, IRI_SUB reads the index files
+         and the coefficients of its month itself; then iriEngineInit
+  sub    warm single profiles with several switch sets (iriWantOutputs,
+         JF_DREGION off, JF_CGM on) at 1 km and 50 km steps, the locations
+         taken in turn from a fixed list so the caches are not all hits
+  web    IRI_WEB sweeps at 300 km, one per ivar (altitude, latitude,
+         longitude, year, month, day, day of year, hour)
+  tec    iriTec of the last profile to 2000 km and to 20000 km (GPS
+         TEC), each first checked against IRI_TEC step 2; a bench run
+         fails if they differ by more than TEC_CHECK
+
+usage: iribench [-t seconds]
+       -t  least time per warm case, default 0.5 s
+
+Output: tab separated on stdout, a header line then one line per case
+    suite case param iters seconds us_per_op
+  param is the height step (sub), ivar (web) or upper height (tec), op
+  is one profile (sub, cold), one step of the sweep (web) or one TEC
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iriengine.h"
+
+#define BENCH_MIN_S 0.5         // least time per warm case
+#define BENCH_LOC 16            // locations per warm case
+#define WEB_LEN 1000            // numstp limit of IRI_WEB
+#define TEC_EPS 1e-3f           // iriTec tolerance of the tec cases
+#define TEC_CHECK 5e-3          // allowed relative difference to IRI_TEC step 2
+
+extern void iri_web_(int *jmag, int jf[], float *alati, float *along, int *iyyyy, int *mmdd, int *iut,
+                     float *dhour, float *height, float *h_tec_max, int *ivar, float *vbeg, float *vend,
+                     float *vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]);
+extern void iri_tec_(float *hstart, float *hend, int *istep, float *tectot, float *tectop, float *tecbot);
+
+// switch sets of the sub cases
+enum bench_set
+{
+    SET_FULL,
+    SET_NE,
+    SET_PEAKS,
+    SET_DREGION_OFF,
+    SET_CGM,
+    SET_NUM
+};
+
+static const char *set_name[SET_NUM] = { "full", "want_ne", "want_peaks", "jf24_off", "jf47_on" };
+
+// IRI_WEB sweeps by ivar: begin, end, step
+static const float web_range[8][3] = {
+    { 80.f, 1000.f, 10.f },     // altitude
+    { -80.f, 80.f, 5.f },       // latitude
+    { 0.f, 350.f, 10.f },       // longitude
+    { 2000.f, 2020.f, 1.f },    // year
+    { 1.f, 12.f, 1.f },         // month
+    { 1.f, 28.f, 3.f },         // day
+    { 1.f, 361.f, 30.f },       // day of year
+    { 0.f, 23.f, 1.f }          // hour
+};
+
+static double min_time = BENCH_MIN_S;
+
+static float outf[2000][OUTF_SIZE];
+static float web_a[WEB_LEN][OUTF_SIZE];
+static float web_b[WEB_LEN][OARR_SIZE];
+
+/*
+benchNow: monotonic time in seconds
+
+return: double
+*/
+static double benchNow(void) {
+    struct timespec ts;
+#ifndef _WIN32
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *suite, const char *name, double param, long iters, double s, long ops) {
+    printf("%s\t%s\t%g\t%ld\t%.6f\t%.3f\n", suite, name, param, iters, s, s / ops * 1e6);
+    fflush(stdout);
+}
+
+/*
+benchInput: the input of profile k of a case, 2015-03-15 to 2015-03-18,
+       heistp km steps from 60 to 2000 km (one height for SET_PEAKS)
+
+return: void
+*/
+static void benchInput(struct iri_input *in, enum bench_set set, float heistp, int k) {
+    iriDefaultInput(in);
+    iriSetSwitch(in, JF_MESSAGES, 0);       // stdout is the result stream
+    in->jmag = 0;
+    in->alati = -75.f + (k % BENCH_LOC) * 10.f;
+    in->along = (k % BENCH_LOC) * 22.5f;
+    in->iyyyy = 2015;
+    in->mmdd = 315 + k % 4;
+    in->dhour = (float)(k * 5 % 24);
+    in->heibeg = 60.f;
+    in->heiend = 2000.f;
+    in->heistp = heistp;
+
+    switch (set) {
+    case SET_NE:
+        iriWantOutputs(in, IRI_WANT_NE);
+        break;
+    case SET_PEAKS:
+        iriWantOutputs(in, IRI_WANT_PEAKS);
+        break;
+    case SET_DREGION_OFF:
+        iriSetSwitch(in, JF_DREGION, 0);
+        break;
+    case SET_CGM:
+        iriSetSwitch(in, JF_CGM, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+benchSub: warm profiles of one switch set at one height step
+
+return: int , 0 on success, -1 if a profile fails
+*/
+static int benchSub(enum bench_set set, float heistp) {
+    struct iri_input in[BENCH_LOC];
+    float oarr[OARR_SIZE];
+    for (int k = 0; k < BENCH_LOC; k++)
+        benchInput(&in[k], set, heistp, k);
+
+    long iters = 0;
+    double s = 0.;
+    do {
+        double t0 = benchNow();
+        for (int k = 0; k < BENCH_LOC; k++)
+            if (iriProfile(&in[k], sizeof(outf) / sizeof(outf[0]), outf, oarr) < 1)
+                return -1;
+        s += benchNow() - t0;
+        iters += BENCH_LOC;
+    } while (s < min_time);
+    report("sub", set_name[set], heistp, iters, s, iters);
+    return 0;
+}
+
+/*
+benchWeb: IRI_WEB sweeps of one ivar, the arguments copied per call since
+       IRI_WEB may change them
+
+return: void
+*/
+static void benchWeb(int ivar) {
+    static const char *var_name[8] = { "altitude", "latitude", "longitude", "year",
+                                       "month", "day", "doy", "hour" };
+    struct iri_input in;
+    benchInput(&in, SET_FULL, 1.f, 3);
+    long steps = (long)((web_range[ivar - 1][1] - web_range[ivar - 1][0]) / web_range[ivar - 1][2]) + 1;
+
+    long iters = 0;
+    double s = 0.;
+    do {
+        int jf[JF_SWITCH];
+        memcpy(jf, in.jf, sizeof(jf));
+        int jmag = in.jmag, iyyyy = in.iyyyy, mmdd = in.mmdd, iut = 0, iv = ivar;
+        float alati = in.alati, along = in.along, dhour = in.dhour;
+        float height = 300.f, h_tec_max = 0.f;
+        float vbeg = web_range[ivar - 1][0], vend = web_range[ivar - 1][1], vstp = web_range[ivar - 1][2];
+        for (int i = 0; i < OARR_SIZE; i++)
+            web_b[0][i] = -1.f;
+
+        double t0 = benchNow();
+        iri_web_(&jmag, jf, &alati, &along, &iyyyy, &mmdd, &iut, &dhour, &height, &h_tec_max, &iv,
+                 &vbeg, &vend, &vstp, web_a, web_b);
+        s += benchNow() - t0;
+        iters++;
+    } while (s < min_time);
+    report("web", var_name[ivar - 1], ivar, iters, s, iters * steps);
+}
+
+/*
+benchTec: iriTec of the profiles of the sub locations, 50 km to hend,
+       after a check of the first against IRI_TEC step 2
+
+return: int , 0 on success, -1 if a profile fails or the TEC is off
+*/
+static int benchTec(float hend) {
+    struct iri_input in[BENCH_LOC];
+    float oarr[OARR_SIZE], top, bot;
+    for (int k = 0; k < BENCH_LOC; k++)
+        benchInput(&in[k], SET_PEAKS, 1.f, k);
+
+    if (iriProfile(&in[0], 1, outf, oarr) < 1)
+        return -1;
+    float hstart = 50.f, h = hend, ref, reft, refb;
+    int istep = 2;
+    iri_tec_(&hstart, &h, &istep, &ref, &reft, &refb);
+    float tec = iriTec(50.f, hend, TEC_EPS, &top, &bot);
+    if (!(fabs(tec - ref) <= TEC_CHECK * ref)) {
+        fprintf(stderr, "iribench: TEC to %g km %g, IRI_TEC %g\n", hend, tec, ref);
+        return -1;
+    }
+
+    long iters = 0;
+    double s = 0.;
+    do {
+        for (int k = 0; k < BENCH_LOC; k++) {
+            if (iriProfile(&in[k], 1, outf, oarr) < 1)
+                return -1;
+            double t0 = benchNow();
+            iriTec(50.f, hend, TEC_EPS, &top, &bot);
+            s += benchNow() - t0;
+        }
+        iters += BENCH_LOC;
+    } while (s < min_time);
+    report("tec", "adaptive", hend, iters, s, iters);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+            min_time = atof(argv[++a]);
+        else {
+            fprintf(stderr, "usage: iribench [-t seconds]\n");
+            return 1;
+        }
+    }
+
+    printf("suite\tcase\tparam\titers\tseconds\tus_per_op\n");
+
+    // cold: nothing read yet in this process
+    struct iri_input in;
+    float oarr[OARR_SIZE];
+    benchInput(&in, SET_FULL, 1.f, 0);
+    double t0 = benchNow();
+    if (iriProfile(&in, sizeof(outf) / sizeof(outf[0]), outf, oarr) < 1) {
+        fprintf(stderr, "iribench: first profile failed\n");
+        return 1;
+    }
+    report("cold", "first_profile", 1., 1, benchNow() - t0, 1);
+
+    struct iri_engine eng;
+    t0 = benchNow();
+    if (iriEngineInit(&eng, 1) != 0)
+        return 1;
+    report("cold", "engine_init", 0., 1, benchNow() - t0, 1);
+
+    t0 = benchNow();
+    iriProfile(&in, sizeof(outf) / sizeof(outf[0]), outf, oarr);
+    report("cold", "second_profile", 1., 1, benchNow() - t0, 1);
+
+    static const float steps[2] = { 1.f, 50.f };
+    for (int set = 0; set < SET_NUM; set++) {
+        for (int i = 0; i < 2; i++) {
+            if (benchSub((enum bench_set)set, steps[i]) != 0) {
+                fprintf(stderr, "iribench: %s profile failed\n", set_name[set]);
+                return 1;
+            }
+            if (set == SET_PEAKS)
+                break;                  // one height whatever the step
+        }
+    }
+
+    for (int ivar = 1; ivar <= 8; ivar++)
+        benchWeb(ivar);
+
+    static const float tec_end[2] = { 2000.f, 20000.f };
+    for (int i = 0; i < 2; i++) {
+        if (benchTec(tec_end[i]) != 0)
+            return 1;
+    }
+
+    iriEngineClose(&eng);
+    return 0;
+}
@@ -0,0 +1,357 @@
+/*
+    IRI result cache: one mapped file per result, see iricache.h
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <direct.h>
+#include <process.h>
+#endif
+
+#include "iricache.h"
+#include "iriindex.h"
+
+#define CACHE_MAGIC "IRICACH"   // 8 bytes with the null
+#define CACHE_ORDER 0x01020304
+#define CACHE_NAME_LEN (CACHE_DIR_LEN + 40)
+#define DREG_ROWS 77            // OUTF(14, 1:77) of IRI_SUB
+
+// header of an entry file, the data follows
+struct cache_head
+{
+    char magic[8];
+    int32_t order;              // 0x01020304 as written, byte order check
+    int32_t version;            // CACHE_VERSION
+    uint64_t stamp;
+    int64_t len;                // data bytes
+    struct iri_cache_key key;
+};
+
+/*
+fnv64: FNV-1a of n bytes, continuing from h
+
+return: uint64_t
+*/
+static uint64_t fnv64(uint64_t h, const void *p, size_t n) {
+    const unsigned char *b = p;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#define FNV64_INIT 0xcbf29ce484222325ULL
+
+/*
+fileStamp: size and modification time of file name into the hash h,
+       -1 for a file that is not there
+
+return: uint64_t
+*/
+static uint64_t fileStamp(uint64_t h, const char *name) {
+    struct stat st;
+    int64_t v[2] = { -1, -1 };
+    if (stat(name, &st) == 0) {
+        v[0] = (int64_t)st.st_size;
+        v[1] = (int64_t)st.st_mtime;
+    }
+    return fnv64(h, v, sizeof(v));
+}
+
+static void entryName(const struct iri_cache *c, const struct iri_cache_key *key, char *name) {
+    unsigned long long h = fnv64(FNV64_INIT, key, sizeof(*key));
+    snprintf(name, CACHE_NAME_LEN, "%s/%016llx.irc", c->dir, h);
+}
+
+/*
+iriCacheOpen: use directory dir for the cache, made if it is not there,
+       and take the stamp of the index and coefficient files: call it
+       after iriEngineInit, when the process has read them
+
+return: int , 0 on success, -1 if dir cannot be made
+*/
+int iriCacheOpen(struct iri_cache *c, const char *dir) {
+    static const char *files[] = { "ig_rz.dat", "apf107.dat", "ccirursi.bin", "igrf2020.dat", "igrf2020s.dat" };
+
+    memset(c, 0, sizeof(*c));
+    if (strlen(dir) >= sizeof(c->dir))
+        return -1;
+    strcpy(c->dir, dir);
+#ifndef _WIN32
+    mkdir(dir, 0777);
+#else
+    _mkdir(dir);
+#endif
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+        return -1;
+
+    int32_t version = CACHE_VERSION;
+    uint64_t h = fnv64(FNV64_INIT, &version, sizeof(version));
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+        h = fileStamp(h, files[i]);
+    for (int m = 11; m <= 22; m++) {
+        char name[16];
+        snprintf(name, sizeof(name), "ccir%d.asc", m);
+        h = fileStamp(h, name);
+        snprintf(name, sizeof(name), "ursi%d.asc", m);
+        h = fileStamp(h, name);
+        snprintf(name, sizeof(name), "mcsat%d.dat", m);
+        h = fileStamp(h, name);
+    }
+    for (int y = 1945; y <= 2015; y += 5) {  // the DGRF epochs of igrf.for before IGRF-2020
+        char name[16];
+        snprintf(name, sizeof(name), "dgrf%d.dat", y);
+        h = fileStamp(h, name);
+    }
+    c->stamp = h;
+    return 0;
+}
+
+/*
+entryMap: the entry of key mapped, if it holds len bytes of data made
+       from the files of this process (hit and miss counted)
+       *m, *mlen: the mapping, for iriUnmapFile
+
+return: const void * , the data, NULL if not there
+*/
+static const void *entryMap(struct iri_cache *c, const struct iri_cache_key *key, size_t len, void **m,
+                            size_t *mlen) {
+    char name[CACHE_NAME_LEN];
+    entryName(c, key, name);
+
+    struct stat st;
+    const struct cache_head *h = *m = iriMapFile(name, mlen, &st);
+    if (h && !(*mlen >= sizeof(*h) + len && memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) == 0
+               && h->order == CACHE_ORDER && h->version == CACHE_VERSION && h->stamp == c->stamp
+               && h->len == (int64_t)len && memcmp(&h->key, key, sizeof(*key)) == 0)) {
+        iriUnmapFile(*m, *mlen);
+        h = NULL;
+    }
+    if (!h) {
+        c->misses++;
+        return NULL;
+    }
+    c->hits++;
+    return h + 1;
+}
+
+/*
+entryWrite: the entry of key, data in nparts parts, to a temporary file
+       renamed over the entry
+
+return: int , 0 on success, -1 if the entry cannot be written
+*/
+static int entryWrite(struct iri_cache *c, const struct iri_cache_key *key, int nparts, const void *part[],
+                      const size_t plen[]) {
+    char name[CACHE_NAME_LEN], tmp[CACHE_NAME_LEN + 24];
+    entryName(c, key, name);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", name, (long)getpid());
+
+    struct cache_head h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.order = CACHE_ORDER;
+    h.version = CACHE_VERSION;
+    h.stamp = c->stamp;
+    for (int i = 0; i < nparts; i++)
+        h.len += (int64_t)plen[i];
+    h.key = *key;
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+        return -1;
+    int bad = fwrite(&h, sizeof(h), 1, fp) != 1;
+    for (int i = 0; i < nparts; i++)
+        bad |= fwrite(part[i], 1, plen[i], fp) != plen[i];
+    if (fclose(fp) != 0 || bad) {
+        remove(tmp);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(name);
+#endif
+    if (rename(tmp, name) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    c->stores++;
+    return 0;
+}
+
+/*
+iriCacheGet: the len bytes of data stored for key
+
+return: int , 1 found, 0 not there (or made from other files)
+*/
+int iriCacheGet(struct iri_cache *c, const struct iri_cache_key *key, void *data, size_t len) {
+    void *m;
+    size_t mlen;
+    const void *d = entryMap(c, key, len, &m, &mlen);
+    if (!d)
+        return 0;
+    memcpy(data, d, len);
+    iriUnmapFile(m, mlen);
+    return 1;
+}
+
+/*
+iriCachePut: store len bytes of data for key, replacing the entry
+
+return: int , 0 on success, -1 if the entry cannot be written
+*/
+int iriCachePut(struct iri_cache *c, const struct iri_cache_key *key, const void *data, size_t len) {
+    return entryWrite(c, key, 1, &data, &len);
+}
+
+/*
+keyInput: the IRI_SUB inputs of in into key (zeroed), jf as 0 / 1
+
+return: void
+*/
+static void keyInput(struct iri_cache_key *key, const struct iri_input *in, int kind, int nh) {
+    memset(key, 0, sizeof(*key));
+    key->kind = kind;
+    key->nh = nh;
+    for (int k = 0; k < JF_SWITCH; k++)
+        key->jf[k] = in->jf[k] != 0;
+    key->jmag = in->jmag;
+    key->iyyyy = in->iyyyy;
+    key->mmdd = in->mmdd;
+    key->alati = in->alati;
+    key->along = in->along;
+    key->dhour = in->dhour;
+    memcpy(key->oarr, in->oarr, sizeof(key->oarr));
+}
+
+/*
+iriCacheKeyProfile: key of the profile of in with nh OUTF rows
+
+return: void
+*/
+void iriCacheKeyProfile(struct iri_cache_key *key, const struct iri_input *in, int nh) {
+    keyInput(key, in, CACHE_PROFILE, nh);
+    key->heibeg = in->heibeg;
+    key->heiend = in->heiend;
+    key->heistp = in->heistp;
+}
+
+/*
+storedRows: OUTF rows kept of a profile of nh heights in OUTF(20, nhmax),
+       IRI_SUB sets them all to -1 first and writes OUTF(14, 1:77) (D-region
+       extras) past the profile; the rows after these are left -1
+
+return: int
+*/
+static int storedRows(int nh, int nhmax) {
+    int n = (nhmax < DREG_ROWS) ? nhmax : DREG_ROWS;
+    return (nh > n) ? nh : n;
+}
+
+/*
+iriCacheGetProfile, iriCachePutProfile: the profile of in with nh heights,
+       OARR and all of OUTF(1:20, 1:nhmax) as IRI_SUB leaves it
+
+return: int , get: 1 found, 0 not there; put: 0 on success, -1 on failure
+*/
+int iriCacheGetProfile(struct iri_cache *c, const struct iri_input *in, int nh, int nhmax, float outf[][OUTF_SIZE],
+                       float oarr[]) {
+    struct iri_cache_key key;
+    int rows = storedRows(nh, nhmax);
+    iriCacheKeyProfile(&key, in, rows);
+    size_t olen = (size_t)rows * OUTF_SIZE * sizeof(float);
+
+    void *m;
+    size_t mlen;
+    const char *d = entryMap(c, &key, OARR_SIZE * sizeof(float) + olen, &m, &mlen);
+    if (!d)
+        return 0;
+    memcpy(oarr, d, OARR_SIZE * sizeof(float));
+    memcpy(outf, d + OARR_SIZE * sizeof(float), olen);
+    iriUnmapFile(m, mlen);
+    for (int i = rows; i < nhmax; i++)
+        for (int j = 0; j < OUTF_SIZE; j++)
+            outf[i][j] = -1.f;
+    return 1;
+}
+
+int iriCachePutProfile(struct iri_cache *c, const struct iri_input *in, int nh, int nhmax,
+                       const float outf[][OUTF_SIZE], const float oarr[]) {
+    struct iri_cache_key key;
+    int rows = storedRows(nh, nhmax);
+    iriCacheKeyProfile(&key, in, rows);
+    const void *part[2] = { oarr, outf };
+    size_t plen[2] = { OARR_SIZE * sizeof(float), (size_t)rows * OUTF_SIZE * sizeof(float) };
+    return entryWrite(c, &key, 2, part, plen);
+}
+
+/*
+iriProfileCached: iriProfile, from the cache if it has the profile,
+       otherwise run and stored.  A profile from the cache leaves no
+       IRI_SUB state behind: no iriTec after it.
+
+return: int , heights filled (at most nhmax), -1 if nhmax < 1
+*/
+int iriProfileCached(struct iri_cache *c, const struct iri_input *in, int nhmax, float outf[][OUTF_SIZE],
+                     float oarr[]) {
+    if (nhmax < 1)
+        return -1;
+    int nh = iriProfileHeights(in);
+    if (nh > nhmax)
+        nh = nhmax;
+    if (iriCacheGetProfile(c, in, nh, nhmax, outf, oarr))
+        return nh;
+
+    nh = iriProfile(in, nhmax, outf, oarr);
+    iriCachePutProfile(c, in, nh, nhmax, (const float(*)[OUTF_SIZE])outf, oarr);
+    return nh;
+}
+
+/*
+iriWebCached: iriWeb, from the cache if it has the sweep, otherwise run
+       and stored
+
+return: int , steps of the sweep
+*/
+int iriWebCached(struct iri_cache *c, const struct iri_input *in, int iut, float height, float h_tec_max,
+                 int ivar, float vbeg, float vend, float vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]) {
+    int nh = iriWebSteps(vbeg, vend, vstp);
+
+    struct iri_cache_key key;
+    keyInput(&key, in, CACHE_WEB, nh);
+    key.iut = iut;
+    key.ivar = ivar;
+    key.height = height;
+    key.h_tec_max = h_tec_max;
+    key.vbeg = vbeg;
+    key.vend = vend;
+    key.vstp = vstp;
+
+    // an altitude sweep is one IRI_SUB call into A, rows as in a profile
+    int rows = (ivar == 1) ? storedRows(nh, OUTF_LEN) : nh;
+    void *m;
+    size_t mlen;
+    size_t blen = (size_t)nh * OARR_SIZE * sizeof(float), alen = (size_t)rows * OUTF_SIZE * sizeof(float);
+    const char *d = entryMap(c, &key, blen + alen, &m, &mlen);
+    if (d) {
+        memcpy(b, d, blen);
+        memcpy(a, d + blen, alen);
+        iriUnmapFile(m, mlen);
+        for (int i = rows; ivar == 1 && i < OUTF_LEN; i++)
+            for (int j = 0; j < OUTF_SIZE; j++)
+                a[i][j] = -1.f;
+        return nh;
+    }
+
+    nh = iriWeb(in, iut, height, h_tec_max, ivar, vbeg, vend, vstp, a, b);
+    const void *part[2] = { b, a };
+    size_t plen[2] = { blen, alen };
+    entryWrite(c, &key, 2, part, plen);
+    return nh;
+}
@@ -0,0 +1,77 @@
+/*
+    IRI result cache: profiles (IRI_SUB) and sweeps (IRI_WEB) kept on disk,
+    one file per result in a cache directory, named by the hash of the
+    canonical key of all inputs.
+
+      <dir>/<16 hex digits>.irc : header (key, stamp, data length), then
+                                  the data of the result
+
+    The stamp is a hash of the size and modification time of the index and
+    coefficient files in the working directory (ig_rz.dat, apf107.dat,
+    ccirursi.bin, ccir%%.asc, ursi%%.asc, mcsat%%.dat, dgrf*.dat and
+    igrf2020*.dat) and of CACHE_VERSION, taken at iriCacheOpen(), after
+    the model is initialized: an entry made from other files is a miss
+    and is replaced by the new result, so updating ig_rz.dat or
+    apf107.dat invalidates the whole cache without any clean up.  A key that hashes to the same name
+    but differs is also a miss.
+
+    Entries are read mapped (iriMapFile) and written to a temporary file
+    renamed over the entry, so any number of processes may share a cache
+    directory: a reader sees either the old or the new entry.  Nothing is
+    evicted, remove the directory to drop the cache.
+*/
+
+#ifndef IRICACHE_H
+#define IRICACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iriengine.h"
+
+#define CACHE_VERSION 2         // bump when the model code changes its results
+#define CACHE_DIR_LEN 256
+
+enum iri_cache_kind
+{
+    CACHE_PROFILE = 1,          // data: OARR(100), OUTF(20, nh), the rows after nh are -1
+    CACHE_WEB                   // data: B(100, nh), A(20, nh)
+};
+
+// every input of a result, jf as 0 / 1, unused fields 0
+struct iri_cache_key
+{
+    int32_t kind;
+    int32_t nh;                 // OUTF rows / steps in the data
+    int32_t jf[JF_SWITCH];
+    int32_t jmag, iyyyy, mmdd;
+    int32_t iut, ivar;          // IRI_WEB
+    float alati, along, dhour;
+    float heibeg, heiend, heistp;
+    float height, h_tec_max;    // IRI_WEB
+    float vbeg, vend, vstp;
+    float oarr[OARR_SIZE];      // OARR input values
+};
+
+struct iri_cache
+{
+    char dir[CACHE_DIR_LEN];
+    uint64_t stamp;             // index and coefficient files of this process
+    long hits, misses, stores;
+};
+
+int iriCacheOpen(struct iri_cache *c, const char *dir);
+int iriCacheGet(struct iri_cache *c, const struct iri_cache_key *key, void *data, size_t len);
+int iriCachePut(struct iri_cache *c, const struct iri_cache_key *key, const void *data, size_t len);
+void iriCacheKeyProfile(struct iri_cache_key *key, const struct iri_input *in, int nh);
+int iriCacheGetProfile(struct iri_cache *c, const struct iri_input *in, int nh, int nhmax, float outf[][OUTF_SIZE],
+                       float oarr[]);
+int iriCachePutProfile(struct iri_cache *c, const struct iri_input *in, int nh, int nhmax,
+                       const float outf[][OUTF_SIZE], const float oarr[]);
+
+int iriProfileCached(struct iri_cache *c, const struct iri_input *in, int nhmax, float outf[][OUTF_SIZE],
+                     float oarr[]);
+int iriWebCached(struct iri_cache *c, const struct iri_input *in, int iut, float height, float h_tec_max,
+                 int ivar, float vbeg, float vend, float vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]);
+
+#endif
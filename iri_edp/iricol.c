@@ -0,0 +1,389 @@
+/*
+    IRI column files, see iricol.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "iricol.h"
+
+#define CODE_MAX(n) (4 * (size_t)(n) + ((size_t)(n) + 1) / 2)   // bytes of a coded block at worst
+
+/*
+xorEncode: n values of a block, per pair a byte of two byte counts (low
+       nibble the first), then the low bytes of each XOR, low byte first
+
+return: size_t , bytes written to out
+*/
+static size_t xorEncode(const uint32_t v[], int n, unsigned char *out) {
+    unsigned char *o = out;
+    uint32_t prev = 0;
+    for (int i = 0; i < n; i += 2) {
+        unsigned char *ctl = o++;
+        *ctl = 0;
+        for (int h = 0; h < 2 && i + h < n; h++) {
+            uint32_t x = v[i + h] ^ prev;
+            prev = v[i + h];
+            int nb = (x > 0xffffff) ? 4 : (x > 0xffff) ? 3 : (x > 0xff) ? 2 : (x != 0);
+            *ctl |= (unsigned char)(nb << (4 * h));
+            for (int b = 0; b < nb; b++)
+                *o++ = (unsigned char)(x >> (8 * b));
+        }
+    }
+    return (size_t)(o - out);
+}
+
+/*
+xorDecode: the n values of a block of len bytes
+
+return: int , 0 on success, -1 if the block is short or corrupt
+*/
+static int xorDecode(const unsigned char *in, size_t len, int n, uint32_t v[]) {
+    const unsigned char *p = in, *end = in + len;
+    uint32_t prev = 0;
+    for (int i = 0; i < n; i += 2) {
+        if (p >= end)
+            return -1;
+        unsigned ctl = *p++;
+        for (int h = 0; h < 2 && i + h < n; h++) {
+            int nb = (ctl >> (4 * h)) & 0xf;
+            if (nb > 4 || (size_t)(end - p) < (size_t)nb)
+                return -1;
+            uint32_t x = 0;
+            for (int b = 0; b < nb; b++)
+                x |= (uint32_t)*p++ << (8 * b);
+            prev ^= x;
+            v[i + h] = prev;
+        }
+    }
+    return 0;
+}
+
+static long blockCount(int64_t rows) {
+    return (long)((rows + ICOL_BLOCK - 1) / ICOL_BLOCK);
+}
+
+/*
+iriColDef: fill in a column definition, name cut to ICOL_NAME_LEN - 1
+
+return: void
+*/
+void iriColDef(struct icol_def *d, const char *name, int type, int kind, int codec) {
+    memset(d, 0, sizeof(*d));
+    strncat(d->name, name, ICOL_NAME_LEN - 1);
+    d->type = type;
+    d->kind = kind;
+    d->codec = codec;
+}
+
+/*
+iriColCreate: column file path for rows rows of the ncols columns def[]
+       (name, type, kind, codec; the offsets are set here)
+
+return: int , 0 on success, -1 on bad columns, if path cannot be written
+        or out of memory
+*/
+int iriColCreate(struct iri_colw *w, const char *path, long rows, int ncols, const struct icol_def def[]) {
+    memset(w, 0, sizeof(*w));
+    if (ncols < 1 || ncols > ICOL_MAX_COLS || rows < 0)
+        return -1;
+    memcpy(w->head.magic, ICOL_MAGIC, sizeof(w->head.magic));
+    w->head.order = ICOL_ORDER;
+    w->head.ncols = ncols;
+    w->head.rows = rows;
+    w->head.block = ICOL_BLOCK;
+
+    // raw columns back to back after the definitions, coded blocks after them
+    int64_t at = (int64_t)sizeof(w->head) + ncols * (int64_t)sizeof(struct icol_def);
+    int ncoded = 0;
+    for (int c = 0; c < ncols; c++) {
+        w->def[c] = def[c];
+        if (def[c].type != ICOL_F32 && def[c].type != ICOL_I32)
+            return -1;
+        if (def[c].codec == ICOL_RAW) {
+            w->def[c].offset = at;
+            at += 4 * (int64_t)rows;
+        } else if (def[c].codec == ICOL_XOR) {
+            w->def[c].offset = ncoded++;        // index slot until iriColFinish
+        } else {
+            return -1;
+        }
+    }
+    w->end = at;
+
+    w->buf = malloc((size_t)ncols * ICOL_BLOCK * sizeof(uint32_t));
+    w->code = malloc(CODE_MAX(ICOL_BLOCK));
+    w->index = calloc((size_t)ncoded * blockCount(rows) * 2 + 1, sizeof(int64_t));
+    w->fp = fopen(path, "wb");
+    if (!w->buf || !w->code || !w->index || !w->fp
+        || fwrite(&w->head, sizeof(w->head), 1, w->fp) != 1
+        || fwrite(w->def, sizeof(struct icol_def), ncols, w->fp) != (size_t)ncols) {
+        if (w->fp)
+            fclose(w->fp);
+        free(w->buf);
+        free(w->code);
+        free(w->index);
+        memset(w, 0, sizeof(*w));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+flushBlock: the rows in buf to the file, raw columns at their place,
+       coded ones appended
+
+return: void , failures in w->status
+*/
+static void flushBlock(struct iri_colw *w) {
+    int n = w->nbuf;
+    long b = (w->row - n) / ICOL_BLOCK;
+    for (int c = 0; c < w->head.ncols && w->status == 0 && n > 0; c++) {
+        const uint32_t *v = w->buf + (size_t)c * ICOL_BLOCK;
+        const struct icol_def *d = &w->def[c];
+        if (d->codec == ICOL_RAW) {
+            if (fseek(w->fp, (long)(d->offset + 4 * (int64_t)(w->row - n)), SEEK_SET) != 0
+                || fwrite(v, 4, n, w->fp) != (size_t)n)
+                w->status = -1;
+        } else {
+            size_t len = xorEncode(v, n, w->code);
+            int64_t *ix = w->index + 2 * (d->offset * blockCount(w->head.rows) + b);
+            ix[0] = w->end;
+            ix[1] = (int64_t)len;
+            if (fseek(w->fp, (long)w->end, SEEK_SET) != 0 || fwrite(w->code, 1, len, w->fp) != len)
+                w->status = -1;
+            w->end += (int64_t)len;
+        }
+    }
+    w->nbuf = 0;
+}
+
+/*
+iriColAppend: the next n rows, val[c] points to n values of column c
+       (float or int32 as its type)
+
+return: int , 0 on success, -1 on a write failure or past the rows of
+        iriColCreate
+*/
+int iriColAppend(struct iri_colw *w, const void *const val[], long n) {
+    if (w->status != 0 || w->row + n > w->head.rows)
+        return -1;
+    for (long r = 0; r < n; ) {
+        int m = ICOL_BLOCK - w->nbuf;
+        if (m > n - r)
+            m = (int)(n - r);
+        for (int c = 0; c < w->head.ncols; c++)
+            memcpy(w->buf + (size_t)c * ICOL_BLOCK + w->nbuf, (const uint32_t *)val[c] + r, m * sizeof(uint32_t));
+        w->nbuf += m;
+        w->row += m;
+        r += m;
+        if (w->nbuf == ICOL_BLOCK)
+            flushBlock(w);
+    }
+    return w->status;
+}
+
+/*
+iriColFinish: write the last block and the block index, close the file
+
+return: int , 0 on success, -1 if a write failed or fewer rows than
+        iriColCreate were appended
+*/
+int iriColFinish(struct iri_colw *w) {
+    if (!w->fp)
+        return -1;
+    flushBlock(w);
+    if (w->row != w->head.rows)
+        w->status = -1;
+
+    long nblock = blockCount(w->head.rows);
+    for (int c = 0; c < w->head.ncols && w->status == 0; c++) {
+        struct icol_def *d = &w->def[c];
+        if (d->codec != ICOL_XOR)
+            continue;
+        const int64_t *ix = w->index + 2 * d->offset * nblock;
+        w->end = (w->end + 7) & ~(int64_t)7;                // int64 aligned in the mapping
+        d->offset = w->end;
+        if (fseek(w->fp, (long)w->end, SEEK_SET) != 0
+            || fwrite(ix, sizeof(int64_t), 2 * nblock, w->fp) != (size_t)(2 * nblock))
+            w->status = -1;
+        w->end += 2 * nblock * (int64_t)sizeof(int64_t);
+    }
+    if (w->status == 0 && (fseek(w->fp, (long)sizeof(w->head), SEEK_SET) != 0
+                           || fwrite(w->def, sizeof(struct icol_def), w->head.ncols, w->fp)
+                              != (size_t)w->head.ncols))
+        w->status = -1;
+    if (fclose(w->fp) != 0)
+        w->status = -1;
+    free(w->buf);
+    free(w->code);
+    free(w->index);
+    w->fp = NULL;
+    w->buf = NULL;
+    w->code = NULL;
+    w->index = NULL;
+    return w->status;
+}
+
+/*
+iriColOpen: map column file path and check it: header, column types
+       and that every column and block index lies within the file
+
+return: int , 0 on success, -1 if it cannot be read or is not a valid
+        column file of this byte order
+*/
+int iriColOpen(struct iri_colr *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return -1;
+#else
+    struct stat st;
+    FILE *fp = fopen(path, "rb");
+    if (!fp || stat(path, &st) != 0 || st.st_size <= 0) {
+        if (fp)
+            fclose(fp);
+        return -1;
+    }
+    void *m = malloc((size_t)st.st_size);
+    if (m && fread(m, 1, (size_t)st.st_size, fp) != (size_t)st.st_size) {
+        free(m);
+        m = NULL;
+    }
+    fclose(fp);
+    if (!m)
+        return -1;
+#endif
+    r->map = m;
+    r->len = (size_t)st.st_size;
+    r->head = m;
+    r->def = (const struct icol_def *)(r->head + 1);
+
+    const struct icol_head *h = r->head;
+    int ok = r->len >= sizeof(*h) && memcmp(h->magic, ICOL_MAGIC, sizeof(h->magic)) == 0
+             && h->order == ICOL_ORDER && h->ncols >= 1 && h->ncols <= ICOL_MAX_COLS && h->rows >= 0
+             && h->block == ICOL_BLOCK && r->len >= sizeof(*h) + h->ncols * sizeof(struct icol_def);
+    for (int c = 0; ok && c < h->ncols; c++) {
+        const struct icol_def *d = &r->def[c];
+        int64_t bytes = (d->codec == ICOL_RAW) ? 4 * h->rows : 2 * blockCount(h->rows) * (int64_t)sizeof(int64_t);
+        ok = (d->type == ICOL_F32 || d->type == ICOL_I32) && (d->codec == ICOL_RAW || d->codec == ICOL_XOR)
+             && d->offset >= 0 && d->offset % ((d->codec == ICOL_RAW) ? 4 : 8) == 0
+             && bytes <= (int64_t)r->len - d->offset;
+    }
+    if (!ok) {
+        iriColClose(r);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+iriColFind: the column named name
+
+return: int , its index, -1 if there is none
+*/
+int iriColFind(const struct iri_colr *r, const char *name) {
+    for (int c = 0; c < r->head->ncols; c++) {
+        if (strncmp(r->def[c].name, name, ICOL_NAME_LEN) == 0)
+            return c;
+    }
+    return -1;
+}
+
+/*
+iriColData: the values of raw column c in the mapping, no copy
+
+return: const void * , NULL for a coded column
+*/
+const void *iriColData(const struct iri_colr *r, int c) {
+    if (c < 0 || c >= r->head->ncols || r->def[c].codec != ICOL_RAW)
+        return NULL;
+    return (const char *)r->map + r->def[c].offset;
+}
+
+/*
+iriColRead: rows row0 .. row0+n-1 of column c into out (4-byte values),
+       a coded column decodes only the blocks holding them
+
+return: int , 0 on success, -1 out of range or on a corrupt block
+*/
+int iriColRead(const struct iri_colr *r, int c, long row0, long n, void *out) {
+    const struct icol_head *h = r->head;
+    if (c < 0 || c >= h->ncols || row0 < 0 || n < 0 || row0 + n > h->rows)
+        return -1;
+    const struct icol_def *d = &r->def[c];
+    const char *base = r->map;
+    if (d->codec == ICOL_RAW) {
+        memcpy(out, base + d->offset + 4 * (int64_t)row0, 4 * (size_t)n);
+        return 0;
+    }
+
+    const int64_t *ix = (const int64_t *)(base + d->offset);
+    uint32_t v[ICOL_BLOCK];
+    uint32_t *o = out;
+    for (long b = row0 / ICOL_BLOCK; n > 0; b++) {
+        int64_t off = ix[2 * b], len = ix[2 * b + 1];
+        long b0 = b * ICOL_BLOCK;
+        int nb = (h->rows - b0 < ICOL_BLOCK) ? (int)(h->rows - b0) : ICOL_BLOCK;
+        if (off < 0 || len < 0 || len > (int64_t)r->len - off
+            || xorDecode((const unsigned char *)base + off, (size_t)len, nb, v) != 0)
+            return -1;
+        int i0 = (int)(row0 - b0), m = nb - i0;
+        if (m > n)
+            m = (int)n;
+        memcpy(o, v + i0, m * sizeof(uint32_t));
+        o += m;
+        row0 += m;
+        n -= m;
+    }
+    return 0;
+}
+
+/*
+iriColClose: unmap the file
+
+return: void
+*/
+void iriColClose(struct iri_colr *r) {
+    if (r->map) {
+#ifndef _WIN32
+        munmap(r->map, r->len);
+#else
+        free(r->map);
+#endif
+    }
+    memset(r, 0, sizeof(*r));
+}
+
+/*
+iriColIsFile: whether path starts with the magic of a column file
+
+return: int , 1 if it does, else 0
+*/
+int iriColIsFile(const char *path) {
+    char magic[8];
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    int yes = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, ICOL_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return yes;
+}
@@ -0,0 +1,123 @@
+/*
+    IRI column files: results as a table of typed columns, one column per
+    parameter (pna name of OARR, or OUTF name), instead of the formatted
+    WRITE(7,7117) / WRITE(18,7227) lines that the C side parses again.
+
+      head     struct icol_head
+      columns  ncols struct icol_def
+      raw      each ICOL_RAW column: rows 4-byte values, contiguous
+      coded    the blocks of the ICOL_XOR columns, in the order written
+      index    per ICOL_XOR column, from def.offset: per block of ICOL_BLOCK
+               rows the int64 offset and int64 length of the block
+
+    Values are 4 bytes (float or int32) in the byte order of the machine.
+    A raw column is read straight from the mapping, value i is at
+    def.offset + 4 i; a coded column is seekable by block: a row range is
+    decoded from the blocks that hold it only.
+
+    ICOL_XOR codes each value as its XOR with the previous value of the
+    block (0 before the first), stored without its leading zero bytes,
+    with a 4-bit byte count per value: close neighbours (heights of a
+    profile, points of a grid) share sign, exponent and top mantissa, so
+    the high bytes are zero; a constant column takes half a byte a value.
+    Lossless, no library needed.
+
+    The writer needs the number of rows up front (the raw columns are laid
+    out at create) and takes the rows in order, a block is written as it
+    fills, so the memory is one block of every column.
+
+    For the median filter and clustering tools (temporal_reader.c) the
+    ICOL_KEY columns are the coordinates (year, mmdd, hour, lat, lon, ...)
+    and the ICOL_VALUE columns are d[0], d[1], ... in file order.
+
+    No IRI code is used here, the tools at the top level build this file
+    on its own.
+*/
+
+#ifndef IRICOL_H
+#define IRICOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ICOL_MAGIC "IRICOL1"    // 8 bytes with the null
+#define ICOL_ORDER 0x01020304
+#define ICOL_NAME_LEN 16
+#define ICOL_MAX_COLS 128       // OARR(100), OUTF(20) and the coordinates
+#define ICOL_BLOCK 4096         // rows per coded block
+
+enum icol_type
+{
+    ICOL_F32 = 1,
+    ICOL_I32
+};
+
+enum icol_kind
+{
+    ICOL_KEY = 1,               // coordinate of the row
+    ICOL_VALUE                  // result
+};
+
+enum icol_codec
+{
+    ICOL_RAW = 0,
+    ICOL_XOR
+};
+
+struct icol_head
+{
+    char magic[8];
+    int32_t order;              // 0x01020304 as written, byte order check
+    int32_t ncols;
+    int64_t rows;
+    int32_t block;              // ICOL_BLOCK
+    int32_t pad;
+};
+
+struct icol_def
+{
+    char name[ICOL_NAME_LEN];
+    int32_t type;               // enum icol_type
+    int32_t kind;               // enum icol_kind
+    int32_t codec;              // enum icol_codec
+    int32_t pad;
+    int64_t offset;             // ICOL_RAW: the values, ICOL_XOR: its block index
+};
+
+struct iri_colw
+{
+    FILE *fp;
+    struct icol_head head;
+    struct icol_def def[ICOL_MAX_COLS];
+    int64_t *index;             // the block index of every coded column
+    int64_t end;                // next coded block goes here
+    long row;                   // rows written
+    int nbuf;                   // rows in buf
+    uint32_t *buf;              // one block per column, buf[c * ICOL_BLOCK + i]
+    unsigned char *code;        // a coded block
+    int status;
+};
+
+struct iri_colr
+{
+    void *map;
+    size_t len;
+    const struct icol_head *head;
+    const struct icol_def *def;
+};
+
+void iriColDef(struct icol_def *d, const char *name, int type, int kind, int codec);
+int iriColCreate(struct iri_colw *w, const char *path, long rows, int ncols, const struct icol_def def[]);
+int iriColAppend(struct iri_colw *w, const void *const val[], long n);
+int iriColFinish(struct iri_colw *w);
+
+int iriColOpen(struct iri_colr *r, const char *path);
+int iriColFind(const struct iri_colr *r, const char *name);
+const void *iriColData(const struct iri_colr *r, int c);
+int iriColRead(const struct iri_colr *r, int c, long row0, long n, void *out);
+void iriColClose(struct iri_colr *r);
+
+int iriColIsFile(const char *path);
+
+#endif
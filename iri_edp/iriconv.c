@@ -0,0 +1,24 @@
+/*
+iriconv: brings the binary index files apf107.bin and ig_rz.bin up to date
+with apf107.dat and ig_rz.dat in the current directory (see iriindex.h).
+Run it again after the text files are updated, only new or changed
+apf107.dat lines are parsed.
+
+usage: iriconv
+*/
+
+#include <stdio.h>
+
+#include "iriindex.h"
+
+int main (void) {
+
+    int parsed = 0;
+    if (iriIndexRefresh(&parsed) != 0) {
+        fprintf(stderr, "iriconv: index files not written\n");
+        return 1;
+    }
+    printf("%s: %d lines parsed, %s up to date\n", APF_DAT, parsed, IGRZ_BIN);
+
+    return 0;
+}
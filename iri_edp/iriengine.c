@@ -0,0 +1,769 @@
+/*
+    IRI engine: batches of IRI_SUB profiles on a pool of worker processes,
+    see iriengine.h
+
+    Work sharing: the workers take the next profile index from a counter in
+    the shared mapping (atomic add), so a slow profile never holds up the
+    others.  A profile is marked done only after its result is written;
+    profiles left undone by a worker that died are run again by the caller.
+    Grid sweeps (iriGridRun) share chunks of grid points the same way.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#else
+#include <process.h>
+#endif
+
+#include "iriengine.h"
+#include "iriprof.h"
+#include "iricache.h"
+#include "iricol.h"
+
+extern void iri_subn_(int jf[], int *jmag, float *alati, float *along, int *iyyyy, int *mmdd,
+                      float *dhour, float *heibeg, float *heiend, float *heistp, int *nhmax,
+                      float outf[][OUTF_SIZE], float oarr[]);
+extern void read_ig_rz_(void);
+extern void readapf107_(void);
+extern void load_ccir_(int *imon, int *ursi, char *filnam, int *ier, size_t filnam_len);
+extern void read_ccir_bin_(void);
+extern void write_ccir_bin_(int *ier);
+extern void igrfep_(int *l);
+extern void iri_flush_(void);
+extern void iri_web_(int *jmag, int jf[], float *alati, float *along, int *iyyyy, int *mmdd, int *iut,
+                     float *dhour, float *height, float *h_tec_max, int *ivar, float *vbeg, float *vend,
+                     float *vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]);
+extern void iri_tec_(float *hstart, float *hend, int *istep, float *tectot, float *tectop, float *tecbot);
+extern void iri_teca_(float *hstart, float *hend, float *eps, float *tectot, float *tectop, float *tecbot);
+extern void gmcsiz_(int *n);
+extern void gmcsta_(int nhit[3], int nmiss[3]);
+
+#define GRID_CHUNK 32           // grid points a worker takes at a time
+#define GRID_SLAB 65536         // grid points run at a time by iriGridWrite
+#define TASK_TAKEN 1            // done flag: a worker runs the task
+#define TASK_DONE 2
+
+// header of the shared mapping, followed by the done flags and the results
+struct batch_shared
+{
+    int next;                   // next profile to take
+    int n;
+};
+
+// task k of a pool run, writes its result into the shared mapping
+typedef void (*pool_task)(void *arg, int k);
+
+/*
+iriDefaultInput: the IRI recommended options, taken from iritest.for
+       jf(4,5,6,21,23,28,29,30,33,35,39,40,47)=.false. all others .true.
+       (FORTRAN index, jf[] is 0-based)
+
+return: void
+*/
+void iriDefaultInput(struct iri_input *in) {
+    static const int jf_off[] = { 4, 5, 6, 21, 23, 28, 29, 30, 33, 35, 39, 40, 47 };
+
+    memset(in, 0, sizeof(*in));
+    for (int i = 0; i < JF_SWITCH; i++)
+        in->jf[i] = 1;
+    for (size_t i = 0; i < sizeof(jf_off) / sizeof(jf_off[0]); i++)
+        in->jf[jf_off[i] - 1] = 0;
+    for (int i = 0; i < OARR_SIZE; i++)
+        in->oarr[i] = -1.0f;
+
+    in->jmag = 0;
+    in->iyyyy = 2000;
+    in->mmdd = 101;
+    in->dhour = 1.5f;
+    in->heibeg = 100.f;
+    in->heiend = 2000.f;
+    in->heistp = 50.f;
+}
+
+/*
+iriSetSwitch: jf switch k (FORTRAN index) to a FORTRAN LOGICAL, any
+       non-zero on is .true.
+
+return: int , 0 , -1 if k is not a switch
+*/
+int iriSetSwitch(struct iri_input *in, enum iri_switch k, int on) {
+    if (k < 1 || k > JF_SWITCH)
+        return -1;
+    in->jf[k - 1] = (on != 0);
+    return 0;
+}
+
+/*
+iriWantOutputs: turn off the sub-models none of the wanted outputs
+       depends on, the other switches are left as they are
+       IRI_WANT_NE: Te/Ti (ELTEIK), ion composition (CALION, CHEMION),
+       ion drift, spread-F, auroral boundary, CGM and the D-region extras
+       (DRegion, F00 for OUTF(14,*)); the storm models change Ne and stay
+       IRI_WANT_PEAKS, IRI_WANT_TEC: as IRI_WANT_NE and one height, heibeg
+
+return: void
+*/
+void iriWantOutputs(struct iri_input *in, enum iri_want want) {
+    static const enum iri_switch unused[] = { JF_TE_TI, JF_NI, JF_DRIFT, JF_SPREADF, JF_AURORAL, JF_CGM,
+                                              JF_DREGION_EXTRA };
+
+    if (want == IRI_WANT_FULL)
+        return;
+    iriSetSwitch(in, JF_NE, 1);
+    for (size_t i = 0; i < sizeof(unused) / sizeof(unused[0]); i++)
+        iriSetSwitch(in, unused[i], 0);
+    if (want == IRI_WANT_PEAKS || want == IRI_WANT_TEC) {
+        in->heiend = in->heibeg;
+        in->heistp = 1.f;
+    }
+}
+
+/*
+iriProfileHeights: number of heights in the range heibeg, heiend, heistp
+       (numhei in IRI_SUB before it is capped), the size iriProfile needs
+
+return: int , 0 if the range has no count (heistp 0, a value not finite
+       or more than INT_MAX heights)
+*/
+int iriProfileHeights(const struct iri_input *in) {
+    float n = fabsf(in->heiend - in->heibeg) / fabsf(in->heistp);
+    if (!(n < INT_MAX))
+        return 0;
+    return (int)n + 1;
+}
+
+/*
+iriHeights: number of heights IRI_SUB fills in an iri_result
+
+return: int
+*/
+int iriHeights(const struct iri_input *in) {
+    int n = iriProfileHeights(in);
+    return (n > OUTF_LEN) ? OUTF_LEN : n;
+}
+
+/*
+iriProfile: one IRI_SUBN call in the calling process, OUTF sized by the caller
+       outf: nhmax heights, outf[i] is OUTF(1:20,i+1) at heibeg + i * heistp
+       oarr: OARR_SIZE values, set from in->oarr before the call
+       the inputs are copied, IRI_SUB may change jf and OARR
+
+return: int , heights filled (at most nhmax), -1 if nhmax < 1
+*/
+int iriProfile(const struct iri_input *in, int nhmax, float outf[][OUTF_SIZE], float oarr[]) {
+    if (nhmax < 1)
+        return -1;
+
+    int jf[JF_SWITCH];
+    memcpy(jf, in->jf, sizeof(jf));
+    memcpy(oarr, in->oarr, OARR_SIZE * sizeof(float));
+
+    int jmag = in->jmag, iyyyy = in->iyyyy, mmdd = in->mmdd;
+    float alati = in->alati, along = in->along, dhour = in->dhour;
+    float heibeg = in->heibeg, heiend = in->heiend, heistp = in->heistp;
+
+    iri_subn_(jf, &jmag, &alati, &along, &iyyyy, &mmdd, &dhour,
+              &heibeg, &heiend, &heistp, &nhmax, outf, oarr);
+
+    int n = iriProfileHeights(in);
+    return (n > nhmax) ? nhmax : n;
+}
+
+/*
+iriTec: TEC of the profile of the last iriProfile / iriSubCall in this
+       process, hstart (not below 100 km) to hend, by adaptive quadrature
+       (iri_teca, iritec.for) to the relative tolerance eps (<= 0 for 1e-3),
+       no further IRI_SUB call
+       top, bot: topside and bottomside content in %, from the same pass
+
+return: float , TEC in m-2
+*/
+float iriTec(float hstart, float hend, float eps, float *top, float *bot) {
+    float tec;
+    IRI_PROF_BEGIN(IRI_STAGE_TEC);
+    iri_teca_(&hstart, &hend, &eps, &tec, top, bot);
+    IRI_PROF_END(IRI_STAGE_TEC);
+    return tec;
+}
+
+/*
+iriSubCall: one IRI_SUB call in the calling process, into an iri_result
+
+return: void
+*/
+void iriSubCall(const struct iri_input *in, struct iri_result *out) {
+    iriProfile(in, OUTF_LEN, out->outf, out->oarr);
+    out->status = 0;
+}
+
+/*
+iriWebSteps: number of steps of an IRI_WEB sweep (numstp), at most OUTF_LEN
+
+return: int
+*/
+int iriWebSteps(float vbeg, float vend, float vstp) {
+    int n = (int)((vend - vbeg) / vstp) + 1;
+    return (n > OUTF_LEN) ? OUTF_LEN : n;
+}
+
+/*
+iriWeb: one IRI_WEB call in the calling process, a sweep of variable
+       ivar (1 altitude, 2 latitude, 3 longitude, 4 year, 5 month, 6 day,
+       7 day of year, 8 hour) from vbeg to vend in vstp steps at height
+       in: switches, location, date and hour of the sweep, heights unused,
+       in->oarr the OARR input of every step
+       iut: 1 dhour is UT, 0 LT
+       a, b: OUTF and OARR per step, OUTF_LEN steps
+
+return: int , steps of the sweep (iriWebSteps)
+*/
+int iriWeb(const struct iri_input *in, int iut, float height, float h_tec_max, int ivar, float vbeg, float vend,
+           float vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]) {
+    int jf[JF_SWITCH];
+    memcpy(jf, in->jf, sizeof(jf));
+    int n = iriWebSteps(vbeg, vend, vstp);
+    for (int i = 0; i < n; i++)
+        memcpy(b[i], in->oarr, OARR_SIZE * sizeof(float));     // OARR input of step i
+
+    int jmag = in->jmag, iyyyy = in->iyyyy, mmdd = in->mmdd;
+    float alati = in->alati, along = in->along, dhour = in->dhour;
+    iri_web_(&jmag, jf, &alati, &along, &iyyyy, &mmdd, &iut, &dhour, &height, &h_tec_max, &ivar,
+             &vbeg, &vend, &vstp, a, b);
+    return n;
+}
+
+/*
+iriEngineInit: read the index files, all CCIR/URSI coefficients and all
+       IGRF maps once in the caller, so every worker forked later starts with them in
+       memory (pages shared until written)
+       nworkers: worker processes, <= 0 for one per online CPU
+
+return: 0 , -1 if a coefficient file is missing
+*/
+int iriEngineInit(struct iri_engine *eng, int nworkers) {
+#ifndef _WIN32
+    if (nworkers <= 0)
+        nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (nworkers <= 0)
+        nworkers = 1;
+    eng->nworkers = nworkers;
+    eng->cache = NULL;
+
+    read_ig_rz_();
+    readapf107_();
+
+    // ccirursi.bin if present, otherwise the ccir%%.asc / ursi%%.asc files
+    char filnam[12];
+    int imon = 0, ursi = 1, ier = 0;
+    read_ccir_bin_();
+    load_ccir_(&imon, &ursi, filnam, &ier, sizeof(filnam));
+    if (ier != 0) {
+        fprintf(stderr, "iriEngineInit: %.12s is not in this directory\n", filnam);
+        return -1;
+    }
+
+    int all_maps = 0;
+    igrfep_(&all_maps);
+
+    return 0;
+}
+
+/*
+iriCoeffWrite: write all CCIR/URSI coefficients to ccirursi.bin, later runs
+       (IRI_SUB or iriEngineInit) load it instead of parsing the text files
+
+return: int , 0 on success, 1 coefficient file missing, 2 write error
+*/
+int iriCoeffWrite(void) {
+    int ier = 0;
+    write_ccir_bin_(&ier);
+    return ier;
+}
+
+/*
+iriGeoCacheSize: entries per table of the IGRF/CGM cache (0 to 1024, a
+       multiple of 4, default 512), 0 turns it off; empties the cache and
+       resets the counters
+       tables: 0 dip/modip, 1 L-value, 2 CGM coordinates
+
+return: void
+*/
+void iriGeoCacheSize(int n) {
+    gmcsiz_(&n);
+}
+
+/*
+iriGeoCacheStats: hits and misses per table since iriGeoCacheSize, counted
+       in the calling process only
+
+return: void
+*/
+void iriGeoCacheStats(int hit[3], int miss[3]) {
+    gmcsta_(hit, miss);
+}
+
+/*
+iriEngineClose
+
+return: void
+*/
+void iriEngineClose(struct iri_engine *eng) {
+    eng->nworkers = 0;
+}
+
+#ifndef _WIN32
+/*
+runWorker: take tasks until none are left, then leave without
+       running the caller's exit handlers; done[k] is TASK_TAKEN while
+       task k runs, TASK_DONE after
+
+return: does not return
+*/
+static void runWorker(struct batch_shared *sh, volatile char *done, pool_task task, void *arg) {
+    for (;;) {
+        int k = __atomic_fetch_add(&sh->next, 1, __ATOMIC_RELAXED);
+        if (k >= sh->n)
+            break;
+        __atomic_store_n(&done[k], TASK_TAKEN, __ATOMIC_RELAXED);
+        task(arg, k);
+        __atomic_store_n(&done[k], TASK_DONE, __ATOMIC_RELEASE);
+    }
+    iri_flush_();
+    fflush(stdout);
+    _exit(0);
+}
+#endif
+
+/*
+poolRun: tasks 0 .. n-1 on nworkers forked workers, the tasks no worker
+       took are run by the caller; a task whose worker died on it is
+       lost (done[k] stays TASK_TAKEN), not run again in the caller,
+       which it could kill as well
+       sh, done: in the shared mapping, done[] n flags
+       nworkers < 2 or _WIN32: all tasks in the caller
+
+return: int , tasks lost
+*/
+static int poolRun(int nworkers, struct batch_shared *sh, volatile char *done, int n, pool_task task,
+                   void *arg) {
+    sh->next = 0;
+    sh->n = n;
+    memset((char *)done, 0, n);
+
+#ifndef _WIN32
+    if (nworkers > 1) {
+        // anything buffered now would be written again by every worker
+        iri_flush_();
+        fflush(NULL);
+
+        pid_t *pid = malloc(nworkers * sizeof(pid_t));
+        int started = 0;
+        for (int w = 0; pid && w < nworkers; w++) {
+            pid_t p = fork();
+            if (p == 0)
+                runWorker(sh, done, task, arg);
+            if (p < 0)
+                break;
+            pid[started++] = p;
+        }
+        for (int w = 0; w < started; w++)
+            waitpid(pid[w], NULL, 0);
+        free(pid);
+    }
+#endif
+
+    int lost = 0;
+    for (int k = 0; k < n; k++) {
+        if (done[k] == TASK_TAKEN) {
+            lost++;
+        } else if (done[k] != TASK_DONE) {
+            task(arg, k);       // serial, or left by workers lost or not started
+            done[k] = TASK_DONE;
+        }
+    }
+    return lost;
+}
+
+/*
+sharedMap: len bytes the workers write and the caller reads, zeroed
+       headlen: bytes for the batch_shared header and done flags, the
+       data follows at a 64 byte boundary (*data)
+
+return: void * , NULL on failure
+*/
+static void *sharedMap(size_t headlen, size_t datalen, size_t *len, void **data) {
+    size_t head = (headlen + 63) / 64 * 64;
+    *len = head + datalen;
+#ifndef _WIN32
+    void *m = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+        return NULL;
+#else
+    void *m = calloc(1, *len);
+    if (!m)
+        return NULL;
+#endif
+    *data = (char *)m + head;
+    return m;
+}
+
+static void sharedUnmap(void *m, size_t len) {
+#ifndef _WIN32
+    munmap(m, len);
+#else
+    (void)len;
+    free(m);
+#endif
+}
+
+struct batch_task
+{
+    const struct iri_input *in;
+    struct iri_result *res;
+};
+
+static void batchTask(void *arg, int k) {
+    struct batch_task *bt = arg;
+    iriSubCall(&bt->in[k], &bt->res[k]);
+}
+
+/*
+runCached: iriEngineRun with eng->cache, the profiles not in the cache
+       are run as a batch of their own (on the pool) and then stored,
+       but for those lost with their worker
+
+return: int , as iriEngineRun
+*/
+static int runCached(struct iri_engine *eng, const struct iri_input in[], struct iri_result out[], int n) {
+    struct iri_cache *c = eng->cache;
+    int *miss = malloc(n * sizeof(int));
+    struct iri_input *min = malloc(n * sizeof(struct iri_input));
+    if (!miss || !min) {
+        free(miss);
+        free(min);
+        return -1;
+    }
+
+    int nmiss = 0;
+    for (int k = 0; k < n; k++) {
+        out[k].status = 0;
+        if (!iriCacheGetProfile(c, &in[k], iriHeights(&in[k]), OUTF_LEN, out[k].outf, out[k].oarr)) {
+            miss[nmiss] = k;
+            min[nmiss++] = in[k];
+        }
+    }
+
+    struct iri_result *mout = (nmiss > 0) ? malloc(nmiss * sizeof(struct iri_result)) : NULL;
+    int status = (nmiss > 0 && !mout) ? -1 : 0;
+    if (mout) {
+        eng->cache = NULL;
+        status = iriEngineRun(eng, min, mout, nmiss);
+        eng->cache = c;
+    }
+    for (int i = 0; status >= 0 && i < nmiss; i++) {
+        int k = miss[i];
+        out[k] = mout[i];
+        if (out[k].status == 0)
+            iriCachePutProfile(c, &in[k], iriHeights(&in[k]), OUTF_LEN,
+                               (const float(*)[OUTF_SIZE])out[k].outf, out[k].oarr);
+    }
+
+    free(mout);
+    free(miss);
+    free(min);
+    return status;
+}
+
+/*
+iriEngineRun: evaluate n profiles, out[k] is the result of in[k]; a
+       profile whose worker died on it has out[k].status -1, the others
+       are done
+
+return: int , 0 on success, 1 if profiles were lost with their worker,
+       -1 if the shared results cannot be allocated
+*/
+int iriEngineRun(struct iri_engine *eng, const struct iri_input in[], struct iri_result out[], int n) {
+    if (eng->cache)
+        return runCached(eng, in, out, n);
+
+    int nworkers = (eng->nworkers < n) ? eng->nworkers : n;
+
+    if (nworkers <= 1) {
+        for (int k = 0; k < n; k++)
+            iriSubCall(&in[k], &out[k]);
+        return 0;
+    }
+
+    size_t len;
+    void *res;
+    void *m = sharedMap(sizeof(struct batch_shared) + n, (size_t)n * sizeof(struct iri_result), &len, &res);
+    if (!m)
+        return -1;
+    struct batch_task bt = { in, res };
+    volatile char *done = (char *)m + sizeof(struct batch_shared);
+    int lost = poolRun(nworkers, m, done, n, batchTask, &bt);
+    memcpy(out, res, (size_t)n * sizeof(struct iri_result));
+    for (int k = 0; lost > 0 && k < n; k++) {
+        if (done[k] == TASK_TAKEN)
+            out[k].status = -1;
+    }
+    sharedUnmap(m, len);
+    return (lost > 0) ? 1 : 0;
+}
+
+/*
+iriGridSize: floats in the grid of iriGridRun, ntime * nlat * nlon * nvar
+
+return: long
+*/
+long iriGridSize(const struct iri_grid *g) {
+    return (long)g->ntime * g->nlat * g->nlon * g->nvar;
+}
+
+struct grid_task
+{
+    const struct iri_grid *g;
+    const int *order;           // time indices in date order
+    long npoint;
+    float *grid;
+};
+
+static const struct iri_time *sortTime;
+
+static int timeCmp(const void *a, const void *b) {
+    const struct iri_time *x = &sortTime[*(const int *)a], *y = &sortTime[*(const int *)b];
+    if (x->iyyyy != y->iyyyy)
+        return (x->iyyyy < y->iyyyy) ? -1 : 1;
+    if (x->mmdd != y->mmdd)
+        return (x->mmdd < y->mmdd) ? -1 : 1;
+    if (x->dhour != y->dhour)
+        return (x->dhour < y->dhour) ? -1 : 1;
+    return 0;
+}
+
+/*
+gridTask: grid points k * GRID_CHUNK .. of the date ordered sweep, point p
+       is time order[p / (nlat * nlon)], then latitude, then longitude
+
+return: void
+*/
+static void gridTask(void *arg, int k) {
+    const struct grid_task *gt = arg;
+    const struct iri_grid *g = gt->g;
+    long nll = (long)g->nlat * g->nlon;
+    long last = (long)(k + 1) * GRID_CHUNK;
+    if (last > gt->npoint)
+        last = gt->npoint;
+
+    struct iri_input in = g->base;
+    float outf[1][OUTF_SIZE], oarr[OARR_SIZE];
+    for (long p = (long)k * GRID_CHUNK; p < last; p++) {
+        int t = gt->order[p / nll];
+        int i = (int)(p % nll / g->nlon), j = (int)(p % g->nlon);
+        in.alati = g->lat0 + i * g->dlat;
+        in.along = g->lon0 + j * g->dlon;
+        in.iyyyy = g->time[t].iyyyy;
+        in.mmdd = g->time[t].mmdd;
+        in.dhour = g->time[t].dhour;
+        in.heibeg = in.heiend = g->height;
+        in.heistp = 1.f;
+        iriProfile(&in, 1, outf, oarr);
+
+        if (g->h_tec_max > 50.f && g->tec_eps > 0.f) {
+            float tecb;
+            oarr[36] = iriTec(50.f, g->h_tec_max, g->tec_eps, &oarr[37], &tecb);
+        } else if (g->h_tec_max > 50.f) {
+            float hstart = 50.f, hend = g->h_tec_max, tec, tect, tecb;
+            int istep = 2;
+            iri_tec_(&hstart, &hend, &istep, &tec, &tect, &tecb);
+            oarr[36] = tec;
+            oarr[37] = tect;
+        }
+
+        float *v = gt->grid + ((long)t * nll + p % nll) * g->nvar;
+        for (int a = 0; a < g->nvar; a++) {
+            int x = g->var[a];
+            v[a] = (x >= 1 && x <= OARR_SIZE) ? oarr[x - 1] : (x <= -1 && x >= -OUTF_SIZE) ? outf[0][-x - 1] : 0.f;
+        }
+    }
+}
+
+/*
+iriGridRun: the selected values of g->var at every point of the grid
+       grid: iriGridSize(g) floats, grid[((t * nlat + i) * nlon + j) * nvar + a]
+       is var[a] at time[t], latitude i, longitude j
+       the points run in date order whatever the order of g->time, in
+       chunks of GRID_CHUNK taken by the workers as they finish
+
+return: int , 0 on success, -1 on a bad grid, if the shared grid cannot be
+       allocated or a chunk was lost with its worker
+*/
+int iriGridRun(struct iri_engine *eng, const struct iri_grid *g, float grid[]) {
+    if (g->nlat < 1 || g->nlon < 1 || g->ntime < 1 || g->nvar < 1 || !g->time || !g->var)
+        return -1;
+
+    int *order = malloc(g->ntime * sizeof(int));
+    if (!order)
+        return -1;
+    for (int t = 0; t < g->ntime; t++)
+        order[t] = t;
+    sortTime = g->time;
+    qsort(order, g->ntime, sizeof(int), timeCmp);
+
+    struct grid_task gt = { g, order, (long)g->ntime * g->nlat * g->nlon, grid };
+    long nchunk = (gt.npoint + GRID_CHUNK - 1) / GRID_CHUNK;
+    int nworkers = (eng->nworkers < nchunk) ? eng->nworkers : (int)nchunk;
+    int status = 0;
+
+    if (nworkers <= 1) {
+        for (long k = 0; k < nchunk; k++)
+            gridTask(&gt, (int)k);
+    } else {
+        size_t len, glen = (size_t)iriGridSize(g) * sizeof(float);
+        void *m = sharedMap(sizeof(struct batch_shared) + nchunk, glen, &len, (void **)&gt.grid);
+        if (m) {
+            if (poolRun(nworkers, m, (char *)m + sizeof(struct batch_shared), (int)nchunk, gridTask, &gt) > 0)
+                status = -1;        // a chunk lost with its worker
+            memcpy(grid, gt.grid, glen);
+            sharedUnmap(m, len);
+        } else {
+            status = -1;
+        }
+    }
+    free(order);
+    return status;
+}
+
+// pna() of iritest.for, OARR(1:86)
+static const char *const oarrName[] = {
+    "NmF2", "hmF2", "NmF1", "hmF1", "NmE", "hmE", "NmD", "hmD", "h05", "B0", "NVmin", "hVtop", "Tpeak",
+    "hTpek", "T300", "T400", "T600", "T1400", "T3000", "T120", "Ti450", "hTeTi", "sza", "sundec", "dip",
+    "diplat", "modip", "Lati", "Srise", "Sset", "season", "Longi", "Rz12", "cov", "B1", "M3000", "TEC",
+    "TECtop", "IG12", "F1prb", "F107d", "C1", "daynr", "vdrft", "foF2r", "F10781", "foEr", "sprd_F", "MLAT",
+    "MLON", "Ap_t", "Ap_d", "invdip", "MLTinv", "CGMlat", "CGMlon", "CGMmlt", "CGM_AB", "CGMm0", "CGMm1",
+    "CGMm2", "CGMm3", "CGMm4", "CGMm5", "CGMm6", "CGMm7", "CGMm8", "CGMm9", "CGMm10", "CGMm11", "CGMm12",
+    "CGMm13", "CGMm14", "CGMm15", "CGMm16", "CGMm17", "CGMm18", "CGMm19", "CGMm20", "CGMm21", "CGMm22",
+    "CGMm23", "kp_t", "dec", "L", "DIMO"
+};
+
+// OUTF(1:11) of IRI_SUB, the others by number
+static const char *const outfName[] = {
+    "Ne", "Tn", "Ti", "Te", "O+", "H+", "He+", "O2+", "NO+", "Clust", "N+"
+};
+
+/*
+iriVarName: name of a grid var (struct iri_grid) in len bytes: the pna
+       name of OARR(var), the OUTF name of -var, else OARRn / OUTFn
+
+return: void
+*/
+void iriVarName(int var, char *name, int len) {
+    int n = (int)(sizeof(oarrName) / sizeof(oarrName[0])), m = (int)(sizeof(outfName) / sizeof(outfName[0]));
+    if (var >= 1 && var <= n)
+        snprintf(name, len, "%s", oarrName[var - 1]);
+    else if (var <= -1 && -var <= m)
+        snprintf(name, len, "%s", outfName[-var - 1]);
+    else
+        snprintf(name, len, (var > 0) ? "OARR%d" : "OUTF%d", (var > 0) ? var : -var);
+}
+
+/*
+iriGridWrite: iriGridRun into column file path, without holding the grid:
+       a slab of times (at least GRID_SLAB points) is run at a time and
+       its values go straight into the columns as they are transposed
+       columns: year, mmdd, hour (ICOL_I32 / F32 keys as struct iri_time),
+       lat, lon (keys), then one per var named by iriVarName; rows in the
+       order of the grid of iriGridRun, time, latitude, longitude
+       codec: ICOL_RAW, or ICOL_XOR to compress the columns
+       the file is written under a temporary name and renamed to path when
+       complete, so path never holds part of a grid
+
+return: int , 0 on success, -1 on a bad grid, out of memory or if the
+        file cannot be written
+*/
+int iriGridWrite(struct iri_engine *eng, const struct iri_grid *g, const char *path, int codec) {
+    if (g->nlat < 1 || g->nlon < 1 || g->ntime < 1 || g->nvar < 1 || g->nvar > ICOL_MAX_COLS - 5
+        || !g->time || !g->var)
+        return -1;
+    long nll = (long)g->nlat * g->nlon;
+    int tslab = (int)((GRID_SLAB + nll - 1) / nll);
+    if (tslab > g->ntime)
+        tslab = g->ntime;
+    long nrow = tslab * nll;
+
+    struct icol_def def[ICOL_MAX_COLS];
+    static const char *const key[] = { "year", "mmdd", "hour", "lat", "lon" };
+    int ncols = 5 + g->nvar;
+    for (int c = 0; c < 5; c++)
+        iriColDef(&def[c], key[c], (c < 2) ? ICOL_I32 : ICOL_F32, ICOL_KEY, codec);
+    for (int a = 0; a < g->nvar; a++) {
+        char name[ICOL_NAME_LEN];
+        iriVarName(g->var[a], name, ICOL_NAME_LEN);
+        iriColDef(&def[5 + a], name, ICOL_F32, ICOL_VALUE, codec);
+    }
+
+    float *grid = malloc((size_t)nrow * g->nvar * sizeof(float));
+    float *col = malloc((size_t)nrow * ncols * sizeof(float));
+    char *tmp = malloc(strlen(path) + 24);
+    if (tmp)
+        sprintf(tmp, "%s.%ld.tmp", path, (long)getpid());
+    struct iri_colw w;
+    int status = (grid && col && tmp) ? iriColCreate(&w, tmp, (long)g->ntime * nll, ncols, def) : -1;
+
+    struct iri_grid s = *g;
+    for (int t0 = 0; status == 0 && t0 < g->ntime; t0 += tslab) {
+        s.time = g->time + t0;
+        s.ntime = (g->ntime - t0 < tslab) ? g->ntime - t0 : tslab;
+        long n = s.ntime * nll;
+        if (iriGridRun(eng, &s, grid) != 0) {
+            status = -1;
+            break;
+        }
+
+        const void *val[ICOL_MAX_COLS];
+        int32_t *yy = (int32_t *)col, *md = yy + n;
+        float *hh = col + 2 * n, *la = col + 3 * n, *lo = col + 4 * n;
+        for (long p = 0; p < n; p++) {
+            const struct iri_time *tm = &s.time[p / nll];
+            yy[p] = tm->iyyyy;
+            md[p] = tm->mmdd;
+            hh[p] = tm->dhour;
+            la[p] = g->lat0 + (int)(p % nll / g->nlon) * g->dlat;
+            lo[p] = g->lon0 + (int)(p % g->nlon) * g->dlon;
+        }
+        for (int a = 0; a < g->nvar; a++) {
+            float *v = col + (5 + a) * n;
+            for (long p = 0; p < n; p++)
+                v[p] = grid[p * g->nvar + a];
+        }
+        for (int c = 0; c < ncols; c++)
+            val[c] = col + c * n;
+        status = iriColAppend(&w, val, n);
+    }
+    if (grid && col && tmp && iriColFinish(&w) != 0)
+        status = -1;
+    if (tmp) {
+#ifdef _WIN32
+        if (status == 0)
+            remove(path);
+#endif
+        if (status != 0 || rename(tmp, path) != 0) {
+            remove(tmp);
+            status = -1;
+        }
+    }
+
+    free(grid);
+    free(col);
+    free(tmp);
+    return status;
+}
@@ -0,0 +1,160 @@
+/*
+    IRI engine: C interface to IRI_SUB (irisub.for) for many profiles.
+
+    IRI_SUB keeps its state in COMMON blocks and SAVE locals, so one process
+    can only run one IRI_SUB at a time.  The engine evaluates a batch of
+    profiles on a pool of worker processes instead of threads: each worker is
+    forked from the (already initialized) caller and holds its own copy of
+    the Fortran state, the results are written straight into shared memory.
+    Every profile is one plain IRI_SUB call, so results are bit-identical
+    to running the batch serially with iriSubCall().
+
+    On _WIN32 (no fork) the batch runs serially.
+
+    A single profile of any number of heights is run with iriProfile(): the
+    caller allocates OUTF for iriProfileHeights() heights, for instance
+    60 to 2000 km in 1 km steps, there is no cap of OUTF_LEN heights.
+
+    Dip/modip, L-value and CGM coordinates per location are kept in an LRU
+    cache (GMCLKP, igrf.for) keyed on latitude, longitude, IGRF epoch and
+    height, sized with iriGeoCacheSize().  The cache is per process: workers
+    start with the entries of the caller and add their own.
+
+    Maps over latitude x longitude x time are run with iriGridRun(): the
+    points are taken by the workers in chunks, in date order, so the points
+    of one date (CCIR month, solar indices) run one after the other in each
+    worker, and the selected OARR / OUTF values go straight into the
+    caller's grid.  iriGridWrite() writes a grid into a column file
+    (iricol.h) a slab of times at a time, one typed column per parameter.
+
+    With a result cache (iricache.h) in eng->cache, iriEngineRun takes
+    the profiles the cache has from it and stores the ones it runs.
+*/
+
+#ifndef IRIENGINE_H
+#define IRIENGINE_H
+
+// const defn shared with iritest.for / irisub.for
+#define JF_SWITCH 50
+#define OARR_SIZE 100
+#define OUTF_SIZE 20
+#define OUTF_LEN 1000           // heights in an iri_result, nummax in IRI_SUB
+
+// jf switches by name, FORTRAN index (see the JF table in irisub.for)
+enum iri_switch
+{
+    JF_NE = 1,                  // Ne computed
+    JF_TE_TI = 2,               // Te, Ti computed
+    JF_NI = 3,                  // Ne & Ni computed
+    JF_DRIFT = 21,              // ion drift computed
+    JF_DREGION = 24,            // D-region: IRI-1990 (else FT-2001 and DRS-1995)
+    JF_FOF2_STORM = 26,         // foF2 storm model
+    JF_SPREADF = 28,            // spread-F probability
+    JF_AURORAL = 33,            // auroral boundary model
+    JF_MESSAGES = 34,           // messages on
+    JF_FOE_STORM = 35,          // foE storm model
+    JF_CGM = 47,                // CGM computation
+    JF_DREGION_EXTRA = 48,      // OUTF(14,1:77) and Danilov-95 if JF_DREGION is off
+    JF_CHEMION_COLD = 49        // CHEMION from a cold start at each height (else seeded from the one below)
+};
+
+// outputs a caller needs, iriWantOutputs turns off what none of them uses
+enum iri_want
+{
+    IRI_WANT_FULL = 0,          // everything the switches ask for
+    IRI_WANT_NE,                // Ne profile, OUTF(1,*) and the peaks
+    IRI_WANT_PEAKS,             // OARR peaks only (NmF2, hmF2, ...), one height
+    IRI_WANT_TEC                // peaks and the profile state for iriTec, one height
+};
+
+/*
+    input of one IRI_SUB call, description taken from irisub.for
+    jf[] follows the FORTRAN index shifted by one: jf[0] is JF(1)
+*/
+struct iri_input
+{
+    int jf[JF_SWITCH];          // FORTRAN LOGICAL: 0 false, 1 true
+    int jmag;                   // =0 geographic, =1 geomagnetic coordinates
+    float alati;                // LATITUDE NORTH AND LONGITUDE EAST IN DEGREES
+    float along;
+    int iyyyy;                  // Year as YYYY
+    int mmdd;                   // DATE (OR DAY OF YEAR AS A NEGATIVE NUMBER)
+    float dhour;                // LOCAL TIME (OR UNIVERSAL TIME + 25) IN DECIMAL HOURS
+    float heibeg;               // HEIGHT RANGE IN KM
+    float heiend;
+    float heistp;
+    float oarr[OARR_SIZE];      // user input values in OARR (see irisub.for), -1 if none
+};
+
+// output of one IRI_SUB call, outf[i] is OUTF(1:20,i+1)
+struct iri_result
+{
+    float outf[OUTF_LEN][OUTF_SIZE];
+    float oarr[OARR_SIZE];
+    int status;                 // 0, or -1 (iriEngineRun) if the worker running it died
+};
+
+struct iri_cache;
+
+struct iri_engine
+{
+    int nworkers;               // worker processes per batch
+    struct iri_cache *cache;    // results kept on disk, NULL for none
+};
+
+// one time of a grid, as in struct iri_input
+struct iri_time
+{
+    int iyyyy;
+    int mmdd;
+    float dhour;                // LT, or UT + 25
+};
+
+/*
+    lat x lon x time grid for iriGridRun, at a single height as iri_web
+    var[] selects the values stored per point, FORTRAN index:
+      1 .. 100   OARR(var), e.g. 1 NmF2, 2 hmF2, 37 TEC
+      -1 .. -20  OUTF(-var) at height, e.g. -1 Ne
+*/
+struct iri_grid
+{
+    struct iri_input base;      // switches, jmag, OARR input; date, hour and heights unused
+    float lat0, dlat;           // latitude lat0 + i * dlat, i < nlat
+    int nlat;
+    float lon0, dlon;           // longitude lon0 + j * dlon, j < nlon
+    int nlon;
+    int ntime;
+    const struct iri_time *time;
+    float height;               // km
+    float h_tec_max;            // > 50: TEC 50 km to h_tec_max in OARR(37), OARR(38), as iri_web
+    float tec_eps;              // > 0: TEC by iriTec to this relative tolerance, else 1 km steps
+    int nvar;
+    const int *var;
+};
+
+void iriDefaultInput(struct iri_input *in);
+int iriSetSwitch(struct iri_input *in, enum iri_switch k, int on);
+void iriWantOutputs(struct iri_input *in, enum iri_want want);
+int iriProfileHeights(const struct iri_input *in);
+int iriProfile(const struct iri_input *in, int nhmax, float outf[][OUTF_SIZE], float oarr[]);
+int iriHeights(const struct iri_input *in);
+float iriTec(float hstart, float hend, float eps, float *top, float *bot);
+void iriSubCall(const struct iri_input *in, struct iri_result *out);
+int iriWebSteps(float vbeg, float vend, float vstp);
+int iriWeb(const struct iri_input *in, int iut, float height, float h_tec_max, int ivar, float vbeg, float vend,
+           float vstp, float a[][OUTF_SIZE], float b[][OARR_SIZE]);
+
+int iriEngineInit(struct iri_engine *eng, int nworkers);
+int iriEngineRun(struct iri_engine *eng, const struct iri_input in[], struct iri_result out[], int n);
+void iriEngineClose(struct iri_engine *eng);
+long iriGridSize(const struct iri_grid *g);
+int iriGridRun(struct iri_engine *eng, const struct iri_grid *g, float grid[]);
+int iriGridWrite(struct iri_engine *eng, const struct iri_grid *g, const char *path, int codec);
+void iriVarName(int var, char *name, int len);
+
+int iriCoeffWrite(void);
+
+void iriGeoCacheSize(int n);
+void iriGeoCacheStats(int hit[3], int miss[3]);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+irigrid: runs a latitude x longitude x time grid of IRI_SUB points
+(iriGridWrite) into a column file (iricol.h), one typed column per
+parameter, for the median filter and clustering tools or any reader of
+iricol.h, instead of formatted WRITE lines.
+
+usage: irigrid [-w workers] [-z] [-u] [-h height] [-T h_tec_max] [-v var,var...] -o file
+               lat0 dlat nlat lon0 dlon nlon yyyy ddd hour dhour ntime
+       time t of ntime: hour + t * dhour hours after day ddd (day of
+           year) of yyyy, local time (-u universal time)
+       -v  grid vars as struct iri_grid: 1..100 OARR(var), -1..-20
+           OUTF(-var) at the height; default 1,2,-1 (NmF2, hmF2, Ne)
+       -h  height in km, default 300
+       -T  TEC from 50 km to h_tec_max into OARR(37), OARR(38)
+       -z  compress the columns (ICOL_XOR)
+
+A grid of one location (nlat = nlon = 1) is a time series: median_filter
+and kmeans_cluster read it as a data file, d[0] the first var.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "iriengine.h"
+#include "iricol.h"
+
+#define GRID_MAX_VARS 32
+
+static int isLeap(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    int nworkers = 0, codec = ICOL_RAW, ut = 0;
+    float height = 300.f, h_tec_max = 0.f;
+    int var[GRID_MAX_VARS] = { 1, 2, -1 }, nvar = 3;
+    const char *path = NULL;
+    int a = 1;
+    for (; a < argc && argv[a][0] == '-' && argv[a][1] && !(argv[a][1] >= '0' && argv[a][1] <= '9'); a++) {
+        if (strcmp(argv[a], "-z") == 0) {
+            codec = ICOL_XOR;
+            continue;
+        }
+        if (strcmp(argv[a], "-u") == 0) {
+            ut = 1;
+            continue;
+        }
+        if (a + 1 >= argc)
+            break;
+        if (strcmp(argv[a], "-w") == 0) {
+            nworkers = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "-h") == 0) {
+            height = (float)atof(argv[++a]);
+        } else if (strcmp(argv[a], "-T") == 0) {
+            h_tec_max = (float)atof(argv[++a]);
+        } else if (strcmp(argv[a], "-o") == 0) {
+            path = argv[++a];
+        } else if (strcmp(argv[a], "-v") == 0) {
+            nvar = 0;
+            for (char *p = argv[++a]; *p && nvar < GRID_MAX_VARS; ) {
+                char *e;
+                int v = (int)strtol(p, &e, 10);
+                if (e == p || v == 0 || v > OARR_SIZE || v < -OUTF_SIZE)
+                    break;
+                var[nvar++] = v;
+                p = (*e == ',') ? e + 1 : e;
+            }
+        } else {
+            break;
+        }
+    }
+    if (!path || nvar < 1 || argc - a != 11) {
+        fprintf(stderr, "usage: irigrid [-w workers] [-z] [-u] [-h height] [-T h_tec_max] [-v var,var...] -o file\n"
+                        "               lat0 dlat nlat lon0 dlon nlon yyyy ddd hour dhour ntime\n");
+        return 1;
+    }
+
+    struct iri_grid g;
+    memset(&g, 0, sizeof(g));
+    iriDefaultInput(&g.base);
+    iriSetSwitch(&g.base, JF_MESSAGES, 0);
+    g.lat0 = (float)atof(argv[a]);
+    g.dlat = (float)atof(argv[a + 1]);
+    g.nlat = atoi(argv[a + 2]);
+    g.lon0 = (float)atof(argv[a + 3]);
+    g.dlon = (float)atof(argv[a + 4]);
+    g.nlon = atoi(argv[a + 5]);
+    int yyyy = atoi(argv[a + 6]), ddd = atoi(argv[a + 7]);
+    double hour = atof(argv[a + 8]), dhour = atof(argv[a + 9]);
+    g.ntime = atoi(argv[a + 10]);
+    g.height = height;
+    g.h_tec_max = h_tec_max;
+    g.nvar = nvar;
+    g.var = var;
+    if (g.nlat < 1 || g.nlon < 1 || g.ntime < 1 || ddd < 1 || ddd > 366) {
+        fprintf(stderr, "irigrid: empty grid or day %d out of range\n", ddd);
+        return 1;
+    }
+
+    // times as day of year (negative mmdd) and decimal hours
+    struct iri_time *time = malloc(g.ntime * sizeof(struct iri_time));
+    if (!time) {
+        fprintf(stderr, "irigrid: out of memory for %d times\n", g.ntime);
+        return 1;
+    }
+    for (int t = 0; t < g.ntime; t++) {
+        double h = hour + t * dhour;
+        long day = ddd + (long)floor(h / 24.);
+        int y = yyyy;
+        while (day > 365 + isLeap(y))
+            day -= 365 + isLeap(y++);
+        while (day < 1)
+            day += 365 + isLeap(--y);
+        time[t].iyyyy = y;
+        time[t].mmdd = -(int)day;
+        time[t].dhour = (float)(h - 24. * floor(h / 24.)) + (ut ? 25.f : 0.f);
+    }
+    g.time = time;
+
+    struct iri_engine eng;
+    if (iriEngineInit(&eng, nworkers) != 0)
+        return 1;
+    int status = iriGridWrite(&eng, &g, path, codec);
+    if (status != 0)
+        fprintf(stderr, "irigrid: cannot write %s\n", path);
+    else
+        fprintf(stderr, "irigrid: %ld points of %d vars in %s\n", (long)g.ntime * g.nlat * g.nlon, nvar, path);
+
+    iriEngineClose(&eng);
+    free(time);
+    return status ? 1 : 0;
+}
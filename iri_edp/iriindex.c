@@ -0,0 +1,503 @@
+/*
+    IRI index store: binary apf107.bin and ig_rz.bin, see iriindex.h
+
+    apf107.dat lines are parsed here with the rules of the formatted READ
+    in readapf107, FORMAT(3I3,9I3,I3,3F5.1): blanks in a field are ignored,
+    an empty field is 0, F5.1 without a decimal point has one implied
+    decimal.  ig_rz.dat is short and has its own post processing
+    (scale factors), it is read by read_ig_rz itself and the resulting
+    COMMON /igrz/ is written out.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "iriindex.h"
+#include "iriprof.h"
+
+#define INDEX_ORDER 0x01020304
+#define INDEX_VERSION 1
+#define APF_LINE 54             // characters read per apf107.dat record
+
+// COMMON /apfa/aap(27000,9),af107(27000,3),n and /igrz/aig(806),arz(806),iymst,iymend
+extern struct
+{
+    int32_t aap[APF_AP][APF_RECS];
+    float af107[APF_F107][APF_RECS];
+    int32_t n;
+} apfa_;
+
+extern struct
+{
+    float aig[IGRZ_VALS];
+    float arz[IGRZ_VALS];
+    int32_t iymst, iymend;
+} igrz_;
+
+extern void read_ig_rz_(void);
+
+static int text_only = 0;       // read_ig_rz must parse ig_rz.dat (refresh)
+
+/*
+iriMapFile: whole file read-only, mapped or (_WIN32) read into memory
+       st: the file status
+
+return: void * , NULL if the file cannot be opened or is empty
+*/
+void *iriMapFile(const char *name, size_t *len, struct stat *st) {
+#ifndef _WIN32
+    int fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, st) != 0 || st->st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *m = mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return NULL;
+    *len = (size_t)st->st_size;
+    IRI_PROF_OPEN(name, (long)st->st_size);
+    return m;
+#else
+    FILE *fp = fopen(name, "rb");
+    if (!fp)
+        return NULL;
+    if (stat(name, st) != 0 || st->st_size <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+    void *m = malloc((size_t)st->st_size);
+    if (m && fread(m, 1, (size_t)st->st_size, fp) != (size_t)st->st_size) {
+        free(m);
+        m = NULL;
+    }
+    fclose(fp);
+    *len = (size_t)st->st_size;
+    IRI_PROF_OPEN(name, (long)st->st_size);
+    return m;
+#endif
+}
+
+void iriUnmapFile(void *m, size_t len) {
+#ifndef _WIN32
+    munmap(m, len);
+#else
+    (void)len;
+    free(m);
+#endif
+}
+
+/*
+headValid: header of the right kind, byte order and version, and the
+       file long enough for its records
+
+return: int , 1 if valid
+*/
+static int headValid(const struct index_head *h, size_t len, const char *magic, int rec_size, int nvals) {
+    if (len < sizeof(*h))
+        return 0;
+    if (strncmp(h->magic, magic, sizeof(h->magic)) != 0 || h->order != INDEX_ORDER
+        || h->version != INDEX_VERSION || h->rec_size != rec_size)
+        return 0;
+    if (h->nrec < 0 || h->nrec > APF_RECS)
+        return 0;
+    return len >= sizeof(*h) + (size_t)h->nrec * rec_size * nvals;
+}
+
+/*
+srcMatches: the text file is the one the binary file was made from,
+       a binary file without its text file is taken as it is
+
+return: int , 1 if it matches
+*/
+static int srcMatches(const struct index_head *h, const char *src) {
+    struct stat st;
+    if (stat(src, &st) != 0)
+        return 1;
+    return h->src_size == (int64_t)st.st_size && h->src_mtime == (int64_t)st.st_mtime;
+}
+
+/*
+writeIndex: header and data to a temporary file, renamed over name
+
+return: int , 0 on success, -1 on failure
+*/
+static int writeIndex(const char *name, const struct index_head *h, const void *data, size_t len) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+        return -1;
+    int bad = fwrite(h, sizeof(*h), 1, fp) != 1 || fwrite(data, 1, len, fp) != len;
+    if (fclose(fp) != 0 || bad) {
+        remove(tmp);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(name);
+#endif
+    return rename(tmp, name) == 0 ? 0 : -1;
+}
+
+static void setHead(struct index_head *h, const char *magic, int rec_size, int nrec, const struct stat *src) {
+    memset(h, 0, sizeof(*h));
+    strncpy(h->magic, magic, sizeof(h->magic));
+    h->order = INDEX_ORDER;
+    h->version = INDEX_VERSION;
+    h->rec_size = rec_size;
+    h->nrec = nrec;
+    h->src_size = (int64_t)src->st_size;
+    h->src_mtime = (int64_t)src->st_mtime;
+}
+
+/*
+daysFromCivil: days since 1970-01-01 of a proleptic Gregorian date
+       based on: http://howardhinnant.github.io/date_algorithms.html
+
+return: long
+*/
+static long daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/*
+lineHash: FNV-1a of one text line, to find the lines that changed
+
+return: uint32_t
+*/
+static uint32_t lineHash(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+fieldText: the non blank characters of columns [pos, pos+w), as the
+       formatted READ sees them (short lines are padded with blanks)
+
+return: int , number of characters
+*/
+static int fieldText(const char *s, size_t n, int pos, int w, char buf[]) {
+    int k = 0;
+    for (int i = pos; i < pos + w && (size_t)i < n; i++)
+        if (s[i] != ' ' && s[i] != '\r')
+            buf[k++] = s[i];
+    buf[k] = '\0';
+    return k;
+}
+
+static int fieldInt(const char *s, size_t n, int pos, int w) {
+    char buf[16];
+    return fieldText(s, n, pos, w, buf) ? atoi(buf) : 0;
+}
+
+static float fieldF1(const char *s, size_t n, int pos, int w) {
+    char buf[16], num[18];
+    int k = fieldText(s, n, pos, w, buf);
+    if (k == 0)
+        return 0.0f;
+    if (strpbrk(buf, ".EeDd"))
+        return strtof(buf, NULL);
+    // one implied decimal: insert the point before the last digit
+    memcpy(num, buf, k - 1);
+    num[k - 1] = '.';
+    num[k] = buf[k - 1];
+    num[k + 1] = '\0';
+    return strtof(num, NULL);
+}
+
+/*
+parseApf: one apf107.dat line into a record, as readapf107 stores it
+
+return: void
+*/
+static void parseApf(const char *s, size_t n, struct apf_rec *r) {
+    for (int j = 0; j < APF_AP; j++)
+        r->ap[j] = fieldInt(s, n, 9 + 3 * j, 3);
+    float f107d = fieldF1(s, n, 39, 5);
+    float f107_81 = fieldF1(s, n, 44, 5);
+    float f107_365 = fieldF1(s, n, 49, 5);
+    if (f107_81 < -4.f) f107_81 = f107d;
+    if (f107_365 < -4.f) f107_365 = f107d;
+    r->f107[0] = f107d;
+    r->f107[1] = f107_81;
+    r->f107[2] = f107_365;
+    r->line_hash = lineHash(s, n);
+}
+
+/*
+mapApf: map apf107.bin
+       check_src: only if it was made from the present apf107.dat
+
+return: int , 0 on success, -1 if missing or not valid
+*/
+static int mapApf(struct index_map *im, int check_src) {
+    struct stat st;
+    memset(im, 0, sizeof(*im));
+    im->base = iriMapFile(APF_BIN, &im->len, &st);
+    if (!im->base)
+        return -1;
+    im->head = im->base;
+    if (!headValid(im->head, im->len, "IRIAPF", sizeof(struct apf_rec), 1)
+        || (check_src && !srcMatches(im->head, APF_DAT))) {
+        iriIndexUnmap(im);
+        return -1;
+    }
+    im->rec = (const struct apf_rec *)(im->head + 1);
+    return 0;
+}
+
+/*
+iriIndexMap, iriIndexUnmap: apf107.bin for C readers, only when it is
+       up to date with apf107.dat
+
+return: int , 0 on success, -1 if missing or stale
+*/
+int iriIndexMap(struct index_map *im) {
+    return mapApf(im, 1);
+}
+
+void iriIndexUnmap(struct index_map *im) {
+    if (im->base)
+        iriUnmapFile(im->base, im->len);
+    memset(im, 0, sizeof(*im));
+}
+
+/*
+iriIndexApf: record of a date, the record number is the day number from
+       the first day of the file
+
+return: const struct apf_rec * , NULL if the date is not in the file
+*/
+const struct apf_rec *iriIndexApf(const struct index_map *im, int yyyy, int mm, int dd) {
+    const int32_t *f = im->head->first;
+    long k = daysFromCivil(yyyy, mm, dd) - daysFromCivil(f[0], f[1], f[2]);
+    if (k < 0 || k >= im->head->nrec)
+        return NULL;
+    return &im->rec[k];
+}
+
+/*
+refreshApf: rewrite apf107.bin from apf107.dat, lines that hash the same
+       as the record already there are not parsed again
+
+return: int , lines parsed, -1 on failure
+*/
+static int refreshApf(void) {
+    struct stat st;
+    size_t tlen;
+    char *txt = iriMapFile(APF_DAT, &tlen, &st);
+    if (!txt) {
+        fprintf(stderr, "%s not found\n", APF_DAT);
+        return -1;
+    }
+    struct index_map old;
+    int nold = (mapApf(&old, 0) == 0) ? old.head->nrec : 0;
+
+    struct apf_rec *rec = malloc(APF_RECS * sizeof(struct apf_rec));
+    int nrec = 0, parsed = 0, first[3] = { 0, 0, 0 };
+    const char *p = txt, *end = txt + tlen;
+    while (rec && p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t n = (nl ? nl : end) - p;
+        if (nrec == APF_RECS) {
+            fprintf(stderr, "%s: more than %d days\n", APF_DAT, APF_RECS);
+            free(rec);
+            rec = NULL;
+            break;
+        }
+        if (nrec == 0) {
+            int jy = fieldInt(p, n, 0, 3);
+            first[0] = jy + (jy < 58 ? 2000 : 1900);    // two digit years from 1958
+            first[1] = fieldInt(p, n, 3, 3);
+            first[2] = fieldInt(p, n, 6, 3);
+        }
+        uint32_t h = lineHash(p, n);
+        if (nrec < nold && old.rec[nrec].line_hash == h) {
+            rec[nrec] = old.rec[nrec];
+        } else {
+            parseApf(p, n, &rec[nrec]);
+            parsed++;
+        }
+        nrec++;
+        p = nl ? nl + 1 : end;
+    }
+    if (nold)
+        iriIndexUnmap(&old);
+    iriUnmapFile(txt, tlen);
+    if (!rec)
+        return -1;
+
+    struct index_head h;
+    setHead(&h, "IRIAPF", sizeof(struct apf_rec), nrec, &st);
+    memcpy(h.first, first, sizeof(first));
+    int ret = writeIndex(APF_BIN, &h, rec, (size_t)nrec * sizeof(struct apf_rec));
+    free(rec);
+    return ret == 0 ? parsed : -1;
+}
+
+/*
+refreshIgrz: rewrite ig_rz.bin from ig_rz.dat (through read_ig_rz) unless
+       it is already up to date
+
+return: int , 0 on success, -1 on failure
+*/
+static int refreshIgrz(void) {
+    struct stat st;
+    if (stat(IGRZ_DAT, &st) != 0) {
+        fprintf(stderr, "%s not found\n", IGRZ_DAT);
+        return -1;
+    }
+    size_t len;
+    struct stat bst;
+    struct index_head *b = iriMapFile(IGRZ_BIN, &len, &bst);
+    if (b) {
+        int current = headValid(b, len, "IRIIGRZ", sizeof(float), 2) && b->nrec == IGRZ_VALS
+                      && srcMatches(b, IGRZ_DAT);
+        iriUnmapFile(b, len);
+        if (current)
+            return 0;
+    }
+
+    text_only = 1;
+    read_ig_rz_();
+    text_only = 0;
+
+    struct index_head h;
+    setHead(&h, "IRIIGRZ", sizeof(float), IGRZ_VALS, &st);
+    h.first[0] = igrz_.iymst;
+    h.first[1] = igrz_.iymend;
+    return writeIndex(IGRZ_BIN, &h, igrz_.aig, sizeof(igrz_.aig) + sizeof(igrz_.arz));
+}
+
+/*
+iriIndexRefresh: bring apf107.bin and ig_rz.bin up to date with the text
+       files in the current directory
+       apf_parsed: apf107.dat lines parsed (new or changed), may be NULL
+
+return: int , 0 on success, -1 on failure
+*/
+int iriIndexRefresh(int *apf_parsed) {
+    int parsed = refreshApf();
+    if (apf_parsed)
+        *apf_parsed = parsed;
+    int ret = refreshIgrz();
+    return (parsed < 0 || ret != 0) ? -1 : 0;
+}
+
+/*
+apf_bin: called from readapf107, COMMON /apfa/ from apf107.bin
+       ier: 0 loaded, 1 not loaded (read apf107.dat)
+
+return: void
+*/
+void apf_bin_(int *ier) {
+    struct index_map im;
+    *ier = 1;
+    if (mapApf(&im, 1) != 0)
+        return;
+    int n = im.head->nrec;
+    for (int k = 0; k < n; k++) {
+        for (int j = 0; j < APF_AP; j++)
+            apfa_.aap[j][k] = im.rec[k].ap[j];
+        for (int j = 0; j < APF_F107; j++)
+            apfa_.af107[j][k] = im.rec[k].f107[j];
+    }
+    apfa_.n = n;
+    iriIndexUnmap(&im);
+    *ier = 0;
+}
+
+/*
+iriIndexMonths: the months ig_rz.dat covers, yyyymm as in COMMON /igrz/,
+       once read_ig_rz has run (0, 0 before); apf107.dat starts in the
+       same month and IRI takes a day after its end with no Ap indices
+
+return: void
+*/
+void iriIndexMonths(int *first, int *last) {
+    *first = igrz_.iymst;
+    *last = igrz_.iymend;
+}
+
+/*
+ccir_stamp: called from read_ccir_bin and write_ccir_bin, FNV-1a of the
+       size and modification time of ccir11.asc .. ursi22.asc, so
+       ccirursi.bin is only used with the text files it was made from
+       stamp: two halves of the hash
+       nsrc: text files present, 0 takes the binary file as it is (as
+       srcMatches)
+
+return: void
+*/
+void ccir_stamp_(int32_t stamp[2], int32_t *nsrc) {
+    uint64_t h = 14695981039346656037ull;
+    *nsrc = 0;
+    for (int set = 0; set < 2; set++) {
+        for (int m = 11; m <= 22; m++) {
+            char name[16];
+            snprintf(name, sizeof(name), set ? "ursi%d.asc" : "ccir%d.asc", m);
+            struct stat st;
+            int64_t v[3] = { -1, -1, 0 };
+            if (stat(name, &st) == 0) {
+                v[0] = (int64_t)st.st_size;
+                v[1] = (int64_t)st.st_mtime;
+#ifndef _WIN32
+                v[2] = (int64_t)st.st_mtim.tv_nsec;     // a file rewritten within the second
+#endif
+                (*nsrc)++;
+            }
+            const unsigned char *p = (const unsigned char *)v;
+            for (size_t i = 0; i < sizeof(v); i++) {
+                h ^= p[i];
+                h *= 1099511628211ull;
+            }
+        }
+    }
+    stamp[0] = (int32_t)(uint32_t)h;
+    stamp[1] = (int32_t)(uint32_t)(h >> 32);
+}
+
+/*
+igrz_bin: called from read_ig_rz, COMMON /igrz/ from ig_rz.bin
+       ier: 0 loaded, 1 not loaded (read ig_rz.dat)
+
+return: void
+*/
+void igrz_bin_(int *ier) {
+    size_t len;
+    struct stat st;
+    *ier = 1;
+    if (text_only)
+        return;
+    struct index_head *h = iriMapFile(IGRZ_BIN, &len, &st);
+    if (!h)
+        return;
+    if (headValid(h, len, "IRIIGRZ", sizeof(float), 2) && h->nrec == IGRZ_VALS && srcMatches(h, IGRZ_DAT)) {
+        const float *v = (const float *)(h + 1);
+        memcpy(igrz_.aig, v, sizeof(igrz_.aig));
+        memcpy(igrz_.arz, v + IGRZ_VALS, sizeof(igrz_.arz));
+        igrz_.iymst = h->first[0];
+        igrz_.iymend = h->first[1];
+        *ier = 0;
+    }
+    iriUnmapFile(h, len);
+}
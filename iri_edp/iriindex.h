@@ -0,0 +1,79 @@
+/*
+    IRI index store: binary copies of apf107.dat and ig_rz.dat
+
+    readapf107 and read_ig_rz (irifun.for) load the binary files when they
+    are up to date with their text files, copying them into
+    COMMON /apfa/ and /igrz/ without any formatted READ.
+
+      apf107.bin : header, then one fixed size record per day from the
+                   first day of apf107.dat (1958-01-01), record k is
+                   AAP(k+1,*), AF107(k+1,*)
+      ig_rz.bin  : header, then AIG(806), ARZ(806) as left by read_ig_rz
+
+    Each header holds the size and modification time of the text file it
+    was made from, a binary file that does not match is not used and the
+    text file is read as before.
+
+    iriIndexRefresh() writes both files.  For apf107.dat only the lines that
+    are new, or differ from the line the record was made from (hash kept
+    per record), are parsed again, so appending days costs only the new
+    lines.  The files are replaced by rename, a process that has the old
+    file mapped keeps reading it.
+*/
+
+#ifndef IRIINDEX_H
+#define IRIINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define APF_RECS 27000          // aap(27000,9), af107(27000,3) in COMMON /apfa/
+#define APF_AP 9                // 8 3-hour Ap indices and the daily Ap
+#define APF_F107 3              // F10.7 daily, 81-day and 365-day averages
+#define IGRZ_VALS 806           // aig(806), arz(806) in COMMON /igrz/
+
+#define APF_BIN "apf107.bin"
+#define APF_DAT "apf107.dat"
+#define IGRZ_BIN "ig_rz.bin"
+#define IGRZ_DAT "ig_rz.dat"
+
+struct index_head
+{
+    char magic[8];              // "IRIAPF" or "IRIIGRZ"
+    int32_t order;              // 0x01020304 as written, byte order check
+    int32_t version;
+    int32_t rec_size;           // bytes per record (apf), per value (ig_rz)
+    int32_t nrec;               // records (apf), values per array (ig_rz)
+    int32_t first[3];           // apf: year, month, day of record 0
+                                // ig_rz: iymst, iymend, unused
+    int32_t pad;
+    int64_t src_size;           // text file the data was made from
+    int64_t src_mtime;
+};
+
+struct apf_rec
+{
+    int32_t ap[APF_AP];         // AAP(k,1:9)
+    float f107[APF_F107];       // AF107(k,1:3)
+    uint32_t line_hash;         // hash of the apf107.dat line
+};
+
+// apf107.bin mapped read-only
+struct index_map
+{
+    void *base;
+    size_t len;
+    const struct index_head *head;
+    const struct apf_rec *rec;
+};
+
+void *iriMapFile(const char *name, size_t *len, struct stat *st);
+void iriUnmapFile(void *m, size_t len);
+int iriIndexRefresh(int *apf_parsed);
+int iriIndexMap(struct index_map *im);
+void iriIndexUnmap(struct index_map *im);
+const struct apf_rec *iriIndexApf(const struct index_map *im, int yyyy, int mm, int dd);
+void iriIndexMonths(int *first, int *last);
+
+#endif
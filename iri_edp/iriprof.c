@@ -0,0 +1,277 @@
+/*
+    IRI profiling: stage timers and file counters, see iriprof.h
+
+    A stage keeps its call count, the time inside it and its nesting depth
+    (only the outermost begin / end is timed).  Trace events are kept in a
+    buffer sized by iriProfTrace(), events beyond it are counted as
+    dropped.  Times are from a monotonic clock, relative to the first use.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "iriprof.h"
+
+#ifdef IRI_PROF
+
+#define NAME_LEN 256            // longest FORTRAN file name kept
+
+extern void gmcsta_(int nhit[3], int nmiss[3]);
+
+struct prof_stage
+{
+    long calls;
+    int depth;
+    double start;
+    double total;               // seconds
+};
+
+struct prof_event
+{
+    double ts;                  // seconds since the origin
+    short stage;                // 0: file opened
+    char ph;                    // 'B', 'E' or 'i'
+};
+
+static const char *stage_name[IRI_STAGE_NUM] = { "open", "IRI_SUB", "CCIR", "FELDCOF", "GEOCGM01",
+                                                 "GTD7", "CHEMION", "F00", "TEC" };
+
+static struct prof_stage stage[IRI_STAGE_NUM];
+static long opens;
+static double open_bytes;
+static double origin = -1., reset_at;
+static int gmc_hit0[3], gmc_miss0[3];   // IGRF/CGM cache counts at the reset
+
+static struct prof_event *event;
+static long nevent, max_event, dropped;
+
+/*
+profNow: monotonic time in seconds since the first call
+
+return: double
+*/
+static double profNow(void) {
+    struct timespec ts;
+#ifndef _WIN32
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    double t = ts.tv_sec + ts.tv_nsec * 1e-9;
+    if (origin < 0.)
+        origin = t;
+    return t - origin;
+}
+
+static void profEvent(int k, char ph, double t) {
+    if (nevent < max_event) {
+        event[nevent].ts = t;
+        event[nevent].stage = (short)k;
+        event[nevent].ph = ph;
+        nevent++;
+    } else if (max_event > 0) {
+        dropped++;
+    }
+}
+
+/*
+iriProfBegin, iriProfEnd: enter and leave stage k
+
+return: void
+*/
+void iriProfBegin(enum iri_stage k) {
+    if (k < 1 || k >= IRI_STAGE_NUM)
+        return;
+    double t = profNow();
+    struct prof_stage *s = &stage[k];
+    s->calls++;
+    if (s->depth++ == 0)
+        s->start = t;
+    profEvent(k, 'B', t);
+}
+
+void iriProfEnd(enum iri_stage k) {
+    if (k < 1 || k >= IRI_STAGE_NUM)
+        return;
+    double t = profNow();
+    struct prof_stage *s = &stage[k];
+    if (s->depth > 0 && --s->depth == 0)
+        s->total += t - s->start;
+    profEvent(k, 'E', t);
+}
+
+/*
+iriProfOpen: a data file of bytes bytes opened (< 0 if unknown)
+
+return: void
+*/
+void iriProfOpen(const char *name, long bytes) {
+    (void)name;
+    opens++;
+    if (bytes > 0)
+        open_bytes += bytes;
+    profEvent(0, 'i', profNow());
+}
+
+// FORTRAN side of the marks, iriprof.inc
+void iprbeg_(const int *k) {
+    iriProfBegin((enum iri_stage)*k);
+}
+
+void iprend_(const int *k) {
+    iriProfEnd((enum iri_stage)*k);
+}
+
+/*
+ipropn_: call ipropn(filnam) after an OPEN, the size from stat() of the
+       name without its trailing blanks
+
+return: void
+*/
+void ipropn_(const char *name, size_t len) {
+    char buf[NAME_LEN];
+    while (len > 0 && name[len - 1] == ' ')
+        len--;
+    if (len >= sizeof(buf))
+        len = sizeof(buf) - 1;
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+
+    struct stat st;
+    iriProfOpen(buf, (stat(buf, &st) == 0) ? (long)st.st_size : -1L);
+}
+
+/*
+iriProfReset: all counts to 0, trace events dropped (the buffer is kept)
+
+return: void
+*/
+void iriProfReset(void) {
+    memset(stage, 0, sizeof(stage));
+    opens = 0;
+    open_bytes = 0.;
+    nevent = dropped = 0;
+    gmcsta_(gmc_hit0, gmc_miss0);
+    reset_at = profNow();
+}
+
+/*
+iriProfTrace: keep up to max_events trace events from now on, 0 stops
+       and frees the buffer
+
+return: int , 0 on success, -1 out of memory
+*/
+int iriProfTrace(long max_events) {
+    free(event);
+    event = NULL;
+    nevent = max_event = dropped = 0;
+    if (max_events <= 0)
+        return 0;
+    event = malloc(max_events * sizeof(struct prof_event));
+    if (!event)
+        return -1;
+    max_event = max_events;
+    return 0;
+}
+
+/*
+iriProfWrite: summary since the last reset, one line per stage called
+
+return: int , 0 on success, -1 on write error
+*/
+int iriProfWrite(FILE *fp) {
+    static const char *table[3] = { "dip/modip", "L-value", "CGM" };
+    double wall = profNow() - reset_at;
+    double sub = stage[IRI_STAGE_SUB].total;
+
+    fprintf(fp, "IRI profile over %.3f s\n", wall);
+    fprintf(fp, "%-10s %10s %12s %12s %9s\n", "stage", "calls", "seconds", "us/call", "%IRI_SUB");
+    for (int k = 1; k < IRI_STAGE_NUM; k++) {
+        const struct prof_stage *s = &stage[k];
+        if (s->calls == 0)
+            continue;
+        fprintf(fp, "%-10s %10ld %12.6f %12.3f %9.1f\n", stage_name[k], s->calls, s->total,
+                s->total / s->calls * 1e6, (sub > 0.) ? s->total / sub * 100. : 0.);
+    }
+    fprintf(fp, "files opened %ld, %.0f bytes\n", opens, open_bytes);
+
+    int hit[3], miss[3];
+    gmcsta_(hit, miss);
+    for (int t = 0; t < 3; t++) {
+        long h = hit[t] - gmc_hit0[t], n = h + miss[t] - gmc_miss0[t];
+        fprintf(fp, "IGRF/CGM cache %-9s %10ld lookups %6.1f %% hits\n", table[t], n,
+                (n > 0) ? h * 100. / n : 0.);
+    }
+    if (max_event > 0)
+        fprintf(fp, "trace events %ld, %ld dropped\n", nevent, dropped);
+    return ferror(fp) ? -1 : 0;
+}
+
+/*
+iriProfTraceWrite: the trace events in the Chrome trace event format,
+       times in microseconds
+
+return: int , 0 on success, -1 if the file cannot be written
+*/
+int iriProfTraceWrite(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return -1;
+
+#ifndef _WIN32
+    long pid = (long)getpid();
+#else
+    long pid = 0;
+#endif
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (long e = 0; e < nevent; e++) {
+        const struct prof_event *ev = &event[e];
+        fprintf(fp, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":0%s}%s\n",
+                stage_name[ev->stage], ev->ph, ev->ts * 1e6, pid, (ev->ph == 'i') ? ",\"s\":\"p\"" : "",
+                (e + 1 < nevent) ? "," : "");
+    }
+    fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+    return (fclose(fp) == 0) ? 0 : -1;
+}
+
+#else
+
+void iriProfBegin(enum iri_stage k) {
+    (void)k;
+}
+
+void iriProfEnd(enum iri_stage k) {
+    (void)k;
+}
+
+void iriProfOpen(const char *name, long bytes) {
+    (void)name;
+    (void)bytes;
+}
+
+void iriProfReset(void) {
+}
+
+int iriProfTrace(long max_events) {
+    (void)max_events;
+    return -1;
+}
+
+int iriProfWrite(FILE *fp) {
+    fprintf(fp, "IRI profile: not built in, make PROF=-DIRI_PROF\n");
+    return -1;
+}
+
+int iriProfTraceWrite(const char *filename) {
+    (void)filename;
+    return -1;
+}
+
+#endif
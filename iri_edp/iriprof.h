@@ -0,0 +1,68 @@
+/*
+    IRI profiling: timers per stage of IRI_SUB and file counters, built in
+    only with -DIRI_PROF (make PROF=-DIRI_PROF), for the FORTRAN and the C
+    code alike.  Without it the marks compile to nothing and the functions
+    below do nothing (-1 where they return a status).
+
+    The FORTRAN code marks a stage with IF(IPROF) CALL IPRBEG(stage) and
+    IPREND(stage) (iriprof.inc), the C code with IRI_PROF_BEGIN / _END.
+      IRI_SUB    one IRI_SUBN call
+      CCIR       read_ccir, CCIR/URSI coefficients of a month
+      FELDCOF    IGRF coefficients for the date
+      GEOCGM01   CGM coordinates (JF_CGM)
+      GTD7       NRLMSISE-00 neutral atmosphere (GTD7, GTD7H)
+      CHEMION    ion composition (JF_NI), per height
+      F00        FT-2001 D-region, per height
+      TEC        iri_tec, iriTec
+    Times are inclusive: a GTD7 call counts in GTD7 and in IRI_SUB.
+    Counted as well: data files opened and their sizes (they are read
+    whole) and the hit rates of the IGRF/CGM cache (GMCLKP, igrf.for).
+
+    iriProfWrite() prints the summary since iriProfReset().  After
+    iriProfTrace() every begin and end is also kept as an event, written by
+    iriProfTraceWrite() in the Chrome trace event format (chrome://tracing,
+    Perfetto).
+
+    All counts are per process and the worker processes of the engine keep
+    their own: profile batches and grids with one worker.
+*/
+
+#ifndef IRIPROF_H
+#define IRIPROF_H
+
+#include <stdio.h>
+
+// stages, FORTRAN numbers of iriprof.inc
+enum iri_stage
+{
+    IRI_STAGE_SUB = 1,
+    IRI_STAGE_CCIR,
+    IRI_STAGE_FELDCOF,
+    IRI_STAGE_CGM,
+    IRI_STAGE_GTD7,
+    IRI_STAGE_CHEMION,
+    IRI_STAGE_F00,
+    IRI_STAGE_TEC,
+    IRI_STAGE_NUM
+};
+
+#ifdef IRI_PROF
+#define IRI_PROF_BEGIN(k) iriProfBegin(k)
+#define IRI_PROF_END(k) iriProfEnd(k)
+#define IRI_PROF_OPEN(name, bytes) iriProfOpen(name, bytes)
+#else
+#define IRI_PROF_BEGIN(k) ((void)0)
+#define IRI_PROF_END(k) ((void)0)
+#define IRI_PROF_OPEN(name, bytes) ((void)0)
+#endif
+
+void iriProfBegin(enum iri_stage k);
+void iriProfEnd(enum iri_stage k);
+void iriProfOpen(const char *name, long bytes);
+
+void iriProfReset(void);
+int iriProfTrace(long max_events);
+int iriProfWrite(FILE *fp);
+int iriProfTraceWrite(const char *filename);
+
+#endif
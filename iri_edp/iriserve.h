@@ -0,0 +1,97 @@
+/*
+    IRI service: profiles and grids from a resident process (iriserved.c)
+    over a local (Unix domain) socket, so a client does not pay for the
+    index files, the CCIR/URSI and IGRF coefficients and the process start
+    on every run.
+
+    A request is a serve_head and its body, the reply a serve_head (status
+    0, or -1 and no body) and the results; a connection may send any
+    number of requests, one at a time.  All values in the byte order of
+    the machine: client and server run on the same host.  A request the
+    server will not run (a date outside ig_rz.dat, jf or jmag not 0 / 1,
+    values not finite, a bad height range) is answered with status -1
+    and the connection stays open.
+      SERVE_PROFILE  request:  n struct iri_input, finite values and
+                               1 .. OUTF_LEN heights each
+                     reply:    per profile int32 heights, float OARR(100),
+                               float OUTF(20, heights), as iribatch -o bin
+      SERVE_GRID     request:  struct serve_grid, ntime struct iri_time,
+                               nvar int32 var (struct iri_grid)
+                     reply:    iriGridSize() floats, as iriGridRun
+      SERVE_STOP     the server answers and exits
+
+    The server reads the requests of every client that sent one, merges
+    the profiles into one batch ordered by date and location and runs each
+    distinct input once (iriEngineRun): concurrent requests for the same
+    month and place share the CCIR month and the IGRF/CGM cache entries of
+    the worker that runs them.  Results are written to the socket from the
+    result arrays and read into the caller's arrays, with no copy between.
+
+    Not on _WIN32: the functions return -1.
+*/
+
+#ifndef IRISERVE_H
+#define IRISERVE_H
+
+#include <stdint.h>
+
+#include "iriengine.h"
+
+#define SERVE_MAGIC 0x31525349          // "ISR1"
+#define SERVE_PATH_LEN 108              // sun_path
+#define SERVE_MAX_PROFILES 4096         // per request
+#define SERVE_MAX_GRID (1L << 26)       // floats per grid reply
+
+enum serve_kind
+{
+    SERVE_PROFILE = 1,
+    SERVE_GRID,
+    SERVE_STOP
+};
+
+struct serve_head
+{
+    uint32_t magic;
+    int32_t kind;
+    int32_t n;                  // request: profiles, reply: profiles or grid floats
+    int32_t status;             // reply: 0 done, -1 failed
+};
+
+// struct iri_grid without the time and var pointers, they follow it
+struct serve_grid
+{
+    struct iri_input base;
+    float lat0, dlat;
+    int32_t nlat;
+    float lon0, dlon;
+    int32_t nlon;
+    int32_t ntime;
+    float height, h_tec_max, tec_eps;
+    int32_t nvar;
+};
+
+// a request as read by the server, iriServeFree releases it
+struct serve_request
+{
+    struct serve_head head;
+    struct iri_input *in;       // SERVE_PROFILE: head.n inputs
+    struct iri_grid grid;       // SERVE_GRID, time and var allocated
+};
+
+// client
+int iriServeConnect(const char *path);
+int iriServeProfiles(int fd, const struct iri_input in[], struct iri_result out[], int n);
+int iriServeProfile(int fd, const struct iri_input *in, int nhmax, float outf[][OUTF_SIZE], float oarr[]);
+int iriServeGrid(int fd, const struct iri_grid *g, float grid[]);
+int iriServeStop(int fd);
+void iriServeClose(int fd);
+
+// server
+int iriServeListen(const char *path);
+int iriServeRead(int fd, struct serve_request *req);
+void iriServeFree(struct serve_request *req);
+int iriServeReply(int fd, int kind, int status, int n);
+int iriServeReplyProfiles(int fd, const struct iri_input *in[], const struct iri_result *out[], int n);
+int iriServeReplyGrid(int fd, const float grid[], long n);
+
+#endif
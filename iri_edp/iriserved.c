@@ -0,0 +1,373 @@
+/*
+iriserved: a resident IRI process serving profiles and grids over a local
+socket (protocol in iriserve.h), so the index files, the CCIR/URSI and
+IGRF coefficients are read once for all the clients.
+
+The model is initialized once (iriEngineInit) before the socket is opened.
+The server then waits for requests; from the first one on it takes the
+requests of all clients for up to the batch window, merges their profiles
+into one batch ordered by year, month, location, date and hour, runs each
+distinct input once on the worker pool and answers every client from the
+shared results.  Grids are run one after the other with iriGridRun.
+
+usage: iriserved [-w workers] [-C dir] [-b msec] <socket>
+       -w  worker processes per batch (default one per CPU)
+       -C  result cache in directory dir (iricache.h), as iribatch
+       -b  batch window in milliseconds (default 2), 0 takes only the
+           requests already sent
+       stops on SIGINT, SIGTERM or a SERVE_STOP request, and removes the
+       socket file
+
+Clients: iriServeConnect() and iriServeProfiles(), iriServeProfile() or
+iriServeGrid(), e.g. assess1 -s socket.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+#include "iriengine.h"
+#include "iricache.h"
+#include "iriserve.h"
+
+#define MAX_CLIENTS 256         // connections at a time
+#define BATCH_MAX 4096          // profiles per batch, SERVE_MAX_PROFILES at least
+#define BATCH_WINDOW 2          // ms
+
+struct client
+{
+    int fd;                     // -1 for a free slot
+    int pending;                // req read, not answered
+    struct serve_request req;
+};
+
+struct server
+{
+    struct iri_engine eng;
+    int lfd;
+    int window;                 // ms
+    struct client client[MAX_CLIENTS];
+    long requests, profiles, distinct, batches;
+};
+
+#ifndef _WIN32
+
+static volatile sig_atomic_t stopping;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void clientClose(struct client *c) {
+    close(c->fd);
+    iriServeFree(&c->req);
+    c->fd = -1;
+    c->pending = 0;
+}
+
+/*
+gather: accept connections and read requests until the batch window,
+       from the first request pending, is over
+
+return: int , requests pending, 0 when stopping
+*/
+static int gather(struct server *s) {
+    struct pollfd pfd[MAX_CLIENTS + 1];
+    int slot[MAX_CLIENTS + 1];
+    int npend = 0;
+    double first = 0.;
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        npend += s->client[i].pending;
+    if (npend > 0)
+        first = nowMs();
+
+    while (!stopping) {
+        int wait = -1;
+        if (npend > 0) {
+            wait = (int)(first + s->window - nowMs());
+            if (wait < 0)
+                wait = 0;
+        }
+
+        int np = 0;
+        pfd[np++] = (struct pollfd){ s->lfd, POLLIN, 0 };
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (s->client[i].fd >= 0 && !s->client[i].pending) {
+                slot[np] = i;
+                pfd[np++] = (struct pollfd){ s->client[i].fd, POLLIN, 0 };
+            }
+        }
+        int r = poll(pfd, np, wait);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+
+        if (pfd[0].revents & POLLIN) {
+            int fd = accept(s->lfd, NULL, NULL);
+            int i = 0;
+            while (i < MAX_CLIENTS && s->client[i].fd >= 0)
+                i++;
+            if (fd >= 0 && i < MAX_CLIENTS)
+                s->client[i].fd = fd;
+            else if (fd >= 0)
+                close(fd);
+        }
+        for (int p = 1; p < np; p++) {
+            struct client *c = &s->client[slot[p]];
+            if (!pfd[p].revents)
+                continue;
+            int rd = iriServeRead(c->fd, &c->req);
+            if (rd == 1 && iriServeReply(c->fd, c->req.head.kind, -1, 0) == 0)
+                continue;               // refused, the client may send another
+            if (rd != 0) {
+                clientClose(c);         // closed by the client, or a request that cannot be read
+                continue;
+            }
+            c->pending = 1;
+            s->requests++;
+            if (npend++ == 0)
+                first = nowMs();
+        }
+        if (npend > 0 && nowMs() >= first + s->window)
+            break;
+    }
+    return stopping ? 0 : npend;
+}
+
+static const struct iri_input **sortIn;
+
+/*
+inputCmp: batch order, year, month (day of year if mmdd < 0), location,
+       then date and hour; equal inputs compare 0
+
+return: int
+*/
+static int inputCmp(const void *a, const void *b) {
+    const struct iri_input *x = sortIn[*(const int *)a], *y = sortIn[*(const int *)b];
+    int mx = (x->mmdd > 0) ? x->mmdd / 100 : x->mmdd, my = (y->mmdd > 0) ? y->mmdd / 100 : y->mmdd;
+    if (x->iyyyy != y->iyyyy)
+        return (x->iyyyy < y->iyyyy) ? -1 : 1;
+    if (mx != my)
+        return (mx < my) ? -1 : 1;
+    if (x->alati != y->alati)
+        return (x->alati < y->alati) ? -1 : 1;
+    if (x->along != y->along)
+        return (x->along < y->along) ? -1 : 1;
+    if (x->mmdd != y->mmdd)
+        return (x->mmdd < y->mmdd) ? -1 : 1;
+    if (x->dhour != y->dhour)
+        return (x->dhour < y->dhour) ? -1 : 1;
+    return memcmp(x, y, sizeof(*x));
+}
+
+/*
+runProfiles: the pending profile requests, as many as fit in BATCH_MAX
+       profiles (at least one request), as one batch; the others stay
+       pending for the next
+
+return: int , requests answered
+*/
+static int runProfiles(struct server *s) {
+    int nreq = 0, total = 0;
+    int member[MAX_CLIENTS];
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        struct client *c = &s->client[i];
+        if (!c->pending || c->req.head.kind != SERVE_PROFILE)
+            continue;
+        if (total > 0 && total + c->req.head.n > BATCH_MAX)
+            continue;
+        member[nreq++] = i;
+        total += c->req.head.n;
+    }
+    if (nreq == 0)
+        return 0;
+
+    const struct iri_input **all = malloc(total * sizeof(*all));
+    const struct iri_result **res = malloc(total * sizeof(*res));
+    int *order = malloc(total * sizeof(int));
+    struct iri_input *uin = malloc(total * sizeof(struct iri_input));
+    struct iri_result *uout = malloc(total * sizeof(struct iri_result));
+    int status = (all && res && order && uin && uout) ? 0 : -1;
+
+    int nu = 0;
+    if (status == 0) {
+        int k = 0;
+        for (int r = 0; r < nreq; r++) {
+            struct client *c = &s->client[member[r]];
+            for (int j = 0; j < c->req.head.n; j++, k++) {
+                all[k] = &c->req.in[j];
+                order[k] = k;
+            }
+        }
+        sortIn = all;
+        qsort(order, total, sizeof(int), inputCmp);
+
+        // equal inputs are next to each other, each is run once
+        for (int i = 0; i < total; i++) {
+            int k = order[i];
+            if (nu == 0 || memcmp(all[k], &uin[nu - 1], sizeof(struct iri_input)) != 0)
+                uin[nu++] = *all[k];
+            res[k] = &uout[nu - 1];
+        }
+        status = iriEngineRun(&s->eng, uin, uout, nu);
+        s->profiles += total;
+        s->distinct += nu;
+        s->batches++;
+    }
+
+    // a profile lost with its worker fails the requests that have it only
+    for (int r = 0, k = 0; r < nreq; r++) {
+        struct client *c = &s->client[member[r]];
+        int n = c->req.head.n, done = (status >= 0);
+        for (int j = 0; done && j < n; j++)
+            done = (res[k + j]->status == 0);
+        int failed = done ? iriServeReplyProfiles(c->fd, &all[k], &res[k], n)
+                          : iriServeReply(c->fd, SERVE_PROFILE, -1, 0);
+        k += n;
+        iriServeFree(&c->req);
+        c->pending = 0;
+        if (failed)
+            clientClose(c);
+    }
+    free(all);
+    free(res);
+    free(order);
+    free(uin);
+    free(uout);
+    return nreq;
+}
+
+/*
+runOthers: the pending grid and stop requests
+
+return: int , 1 if a client asked to stop, else 0
+*/
+static int runOthers(struct server *s) {
+    int stop = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        struct client *c = &s->client[i];
+        if (!c->pending || c->req.head.kind == SERVE_PROFILE)
+            continue;
+
+        int failed;
+        if (c->req.head.kind == SERVE_GRID) {
+            long n = iriGridSize(&c->req.grid);
+            float *grid = malloc(n * sizeof(float));
+            if (grid && iriGridRun(&s->eng, &c->req.grid, grid) == 0)
+                failed = iriServeReplyGrid(c->fd, grid, n);
+            else
+                failed = iriServeReply(c->fd, SERVE_GRID, -1, 0);
+            free(grid);
+        } else {
+            failed = iriServeReply(c->fd, SERVE_STOP, 0, 0);
+            stop = 1;
+        }
+        iriServeFree(&c->req);
+        c->pending = 0;
+        if (failed)
+            clientClose(c);
+    }
+    return stop;
+}
+
+int main(int argc, char *argv[]) {
+
+    static struct server s;
+    int nworkers = 0;
+    const char *cache_dir = NULL;
+    s.window = BATCH_WINDOW;
+    int a = 1;
+    for (; a + 1 < argc && argv[a][0] == '-' && argv[a][1]; a += 2) {
+        if (strcmp(argv[a], "-w") == 0)
+            nworkers = atoi(argv[a + 1]);
+        else if (strcmp(argv[a], "-C") == 0)
+            cache_dir = argv[a + 1];
+        else if (strcmp(argv[a], "-b") == 0)
+            s.window = atoi(argv[a + 1]);
+        else
+            break;
+    }
+    if (a + 1 != argc || strlen(argv[a]) >= SERVE_PATH_LEN) {
+        fprintf(stderr, "usage: iriserved [-w workers] [-C dir] [-b msec] <socket>\n");
+        return 1;
+    }
+    const char *path = argv[a];
+
+    if (iriEngineInit(&s.eng, nworkers) != 0)
+        return 1;
+    struct iri_cache cache;
+    if (cache_dir) {
+        if (iriCacheOpen(&cache, cache_dir) != 0) {
+            fprintf(stderr, "iriserved: cannot use %s as the result cache\n", cache_dir);
+            return 1;
+        }
+        s.eng.cache = &cache;
+    }
+
+    s.lfd = iriServeListen(path);
+    if (s.lfd < 0) {
+        fprintf(stderr, "iriserved: cannot listen on %s\n", path);
+        return 1;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        s.client[i].fd = -1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;          // no SA_RESTART, poll returns EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);           // a client gone is a failed write
+    fprintf(stderr, "iriserved: %d workers, listening on %s\n", s.eng.nworkers, path);
+
+    while (gather(&s) > 0) {
+        int stop = runOthers(&s);
+        runProfiles(&s);
+        if (stop) {
+            while (runProfiles(&s) > 0)
+                ;
+            break;
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (s.client[i].fd >= 0)
+            clientClose(&s.client[i]);
+    }
+    close(s.lfd);
+    unlink(path);
+    fprintf(stderr, "iriserved: %ld requests, %ld profiles, %ld run in %ld batches\n", s.requests, s.profiles,
+            s.distinct, s.batches);
+    if (cache_dir)
+        fprintf(stderr, "iriserved: cache %ld hits, %ld misses, %ld stored\n", cache.hits, cache.misses,
+                cache.stores);
+    iriEngineClose(&s.eng);
+    return 0;
+}
+
+#else
+
+int main(void) {
+    fprintf(stderr, "iriserved: needs Unix domain sockets and fork, not on Windows\n");
+    return 1;
+}
+
+#endif
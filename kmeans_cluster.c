@@ -0,0 +1,438 @@
+/*
+    Program: k-means clustering of the temporal data, the native
+             counterpart of rd_sci_clustering.ipynb: the features are
+             standardized (as sklearn.preprocessing.scale) and clustered by
+             k-means++ / Hamerly k-means (kmeans_engine.c), the best of
+             n_init runs is kept.
+
+             The input is either a data file of the median filter (read by
+             temporal_reader.c, columns by d[] index, optionally median
+             filtered first, so the clustering runs on the filtered values)
+             or a tab separated table with a header row and the index in
+             the first column, as cluster_raw.dat of the notebook (columns
+             by header name).
+
+             -m streams a data file of any size in bounded memory instead
+             (kmeans_stream): one pass with running standardization and
+             mini-batch k-means as the chunks are read, in file order; with
+             -l a second pass writes the labels and gives the counts and
+             inertia of the final centres.
+
+    usage:   kmeans_cluster [-k clusters] [-n n_init] [-i max_iter] [-s seed]
+                            [-j threads] [-f width] [-l labels] [-t]
+                            [-m] [-b batch] <input filename> [column ...]
+             -f  median filter the columns with this window width first
+             -l  write the cluster of each row, one per line, to labels
+             -t  the input is a tab separated table, columns are names
+             -m  out of core mini-batch k-means (not with -f or -t),
+                 n_init/max_iter/seed apply to the seeding
+             -b  rows per mini-batch, default KMEANS_BATCH
+             column: d[] index 0..FLOAT_DATA-1, default 0 5 (foF2, hmF2);
+                     with -t header names, default x0 x1 x2 x3 x4
+
+    Output:  per cluster the number of rows and the centre, standardized
+             and in the units of the input, and the inertia
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#include "kmeans_engine.h"
+#include "median_engine.h"
+#include "temporal_reader.h"
+
+#define DAT0 0                  // default columns, foF2 & hmF2 as median_filter
+#define DAT1 5
+#define TABLE_LINE 4096         // longest line of a table file
+#define TABLE_NAME_LEN 32
+
+/*
+Function: splitTabs
+          cut line at the tabs (and the line end) in place
+
+return: int , number of fields, at most max
+*/
+static int splitTabs(char *line, char *field[], int max) {
+    int n = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *p = line; n < max; p++) {
+        field[n++] = p;
+        p = strchr(p, '\t');
+        if (!p)
+            break;
+        *p = '\0';
+    }
+    return n;
+}
+
+/*
+Function: readTable
+          the named columns of a tab separated table with a header row,
+          the first column (the index) is skipped; rows that do not parse
+          are skipped with a message
+          col: ncols arrays allocated here, grown as rows are read
+
+return: int , number of rows, -1 on failure
+*/
+static int readTable(const char *filename, char names[][TABLE_NAME_LEN], int ncols, float *col[]) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+        return -1;
+
+    char line[TABLE_LINE];
+    char *field[TABLE_LINE / 2];
+    int at[KMEANS_MAX_COLS];
+    int nf = fgets(line, sizeof(line), fp) ? splitTabs(line, field, TABLE_LINE / 2) : 0;
+    for (int c = 0; c < ncols; c++) {
+        at[c] = -1;
+        for (int f = 1; f < nf; f++) {
+            if (strcmp(field[f], names[c]) == 0)
+                at[c] = f;
+        }
+        if (at[c] < 0) {
+            fprintf(stderr, "%s: no column %s\n", filename, names[c]);
+            fclose(fp);
+            return -1;
+        }
+        col[c] = NULL;
+    }
+
+    int rows = 0, cap = 0;
+    long lineno = 1;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+        nf = splitTabs(line, field, TABLE_LINE / 2);
+        float v[KMEANS_MAX_COLS];
+        int ok = 1;
+        for (int c = 0; ok && c < ncols; c++) {
+            char *e = NULL;
+            ok = (at[c] < nf);
+            if (ok)
+                v[c] = strtof(field[at[c]], &e);
+            ok = ok && e != field[at[c]];
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: line %ld skipped\n", filename, lineno);
+            continue;
+        }
+        if (rows == cap) {
+            cap = cap ? 2 * cap : READ_CHUNK;
+            for (int c = 0; c < ncols; c++) {
+                float *p = realloc(col[c], cap * sizeof(float));
+                if (!p) {
+                    fclose(fp);
+                    return -1;
+                }
+                col[c] = p;
+            }
+        }
+        for (int c = 0; c < ncols; c++)
+            col[c][rows] = v[c];
+        rows++;
+    }
+    fclose(fp);
+    return rows;
+}
+
+/*
+Function: printClusters
+          per cluster the rows and the centre, in the units of the input
+          and standardized
+
+return: void
+*/
+static void printClusters(const struct kmeans_model *model, char names[][TABLE_NAME_LEN], int ncols,
+                          const float mean[], const float sd[]) {
+    printf("cluster\trows");
+    for (int c = 0; c < ncols; c++)
+        printf("\t%s", names[c]);
+    for (int c = 0; c < ncols; c++)
+        printf("\t%s(scaled)", names[c]);
+    printf("\n");
+    for (int m = 0; m < model->k; m++) {
+        printf("%d\t%ld", m, model->count[m]);
+        for (int c = 0; c < ncols; c++)
+            printf("\t%g", model->centre[m][c] * sd[c] + mean[c]);
+        for (int c = 0; c < ncols; c++)
+            printf("\t%.6f", model->centre[m][c]);
+        printf("\n");
+    }
+}
+
+/*
+Function: streamCluster
+          -m: mini-batch k-means over the chunks of the reader, then with
+          a label file a second pass for the labels, counts and inertia
+
+return: int , 0 on success, 1 on failure (message printed)
+*/
+static int streamCluster(const char *filename, const int cols[], int ncols, char names[][TABLE_NAME_LEN],
+                         const struct kmeans_opts *opts, int batch, const char *label_file) {
+    struct kmeans_stream ks;
+    struct temporal_reader rd;
+    struct temporal_chunk *chunk = malloc(sizeof(*chunk));
+    if (!chunk || kmeansStreamInit(&ks, opts, ncols, batch) != 0) {
+        fprintf(stderr, "k-means: out of memory\n");
+        free(chunk);
+        return 1;
+    }
+    const float *col[FLOAT_DATA];
+    for (int c = 0; c < ncols; c++)
+        col[c] = chunk->col[c];
+
+    clock_t t0 = clock();
+    int status = 0;
+    if (temporalReaderOpen(&rd, filename, cols, ncols) != 0) {
+        fprintf(stderr, "Cannot read file ");
+        perror(filename);
+        status = 1;
+    }
+    int n = 0;
+    while (status == 0 && (n = temporalReaderRead(&rd, chunk)) > 0) {
+        if (kmeansStreamAdd(&ks, col, chunk->rows) != 0)
+            status = -1;
+    }
+    if (n < 0) {
+        fprintf(stderr, "%s: truncated or corrupt after row %ld\n", filename, rd.col_row);
+        status = 1;
+        temporalReaderClose(&rd);
+    }
+    if (status != 1) {
+        if (rd.skipped > 0)
+            fprintf(stderr, "%s: %ld malformed rows skipped\n", filename, rd.skipped);
+        temporalReaderClose(&rd);
+    }
+
+    struct kmeans_model model;
+    float mean[KMEANS_MAX_COLS], sd[KMEANS_MAX_COLS];
+    if (status == 0 && kmeansStreamModel(&ks, &model, mean, sd) != 0)
+        status = -1;
+    if (status < 0)
+        fprintf(stderr, "%s: %ld rows, fewer than %d clusters or out of memory\n", filename, ks.rows, opts->k);
+    if (status != 0) {
+        kmeansStreamFree(&ks);
+        free(chunk);
+        return 1;
+    }
+    printf("%ld rows, %d columns, k %d, mini-batches of %d: %d batches, inertia %.6g (%.3f s cpu)\n",
+           ks.rows, ncols, model.k, ks.batch, model.iter, model.inertia,
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    // second pass: labels, counts and inertia of the final centres
+    if (label_file) {
+        FILE *fp = fopen(label_file, "w");
+        int *label = malloc(READ_CHUNK * sizeof(int));
+        if (!fp || !label || temporalReaderOpen(&rd, filename, cols, ncols) != 0) {
+            perror(fp && label ? filename : label_file);
+            status = 1;
+        }
+        if (status == 0) {
+            memset(model.count, 0, sizeof(model.count));
+            model.inertia = 0.;
+            while ((n = temporalReaderRead(&rd, chunk)) > 0) {
+                kmeansStreamLabel(&ks, col, chunk->rows, label, &model);
+                for (int i = 0; i < chunk->rows; i++)
+                    fprintf(fp, "%d\n", label[i]);
+            }
+            if (n < 0) {
+                fprintf(stderr, "%s: truncated or corrupt after row %ld\n", filename, rd.col_row);
+                status = 1;
+            } else {
+                printf("second pass: inertia %.6g of the final centres\n", model.inertia);
+            }
+            temporalReaderClose(&rd);
+        }
+        if (fp && fclose(fp) != 0) {
+            perror(label_file);
+            status = 1;
+        }
+        free(label);
+    }
+    if (status == 0)
+        printClusters(&model, names, ncols, mean, sd);
+
+    kmeansStreamFree(&ks);
+    free(chunk);
+    return status;
+}
+
+/*
+Function: argInt
+          a whole argument as a decimal int, strtol with nothing left over
+
+return: int , 0 on success, -1 if it is not a number or out of int range
+*/
+static int argInt(const char *s, int *v) {
+    char *e;
+    errno = 0;
+    long x = strtol(s, &e, 10);
+    if (e == s || *e != '\0' || errno == ERANGE || x < INT_MIN || x > INT_MAX)
+        return -1;
+    *v = (int)x;
+    return 0;
+}
+
+/*
+Function: main
+          read the features, filter them if asked, standardize, cluster
+          and print the clusters
+
+return: int
+*/
+int main(int argc, char *argv[]) {
+
+    struct kmeans_opts opts;
+    kmeansDefaultOpts(&opts);
+    int width = 0, table = 0, stream = 0, batch = 0, bad = 0;
+    const char *label_file = NULL;
+    int a = 1;
+    for (; a < argc && argv[a][0] == '-' && argv[a][1]; a++) {
+        if (strcmp(argv[a], "-t") == 0) {
+            table = 1;
+            continue;
+        }
+        if (strcmp(argv[a], "-m") == 0) {
+            stream = 1;
+            continue;
+        }
+        if (a + 1 >= argc)
+            break;
+        char *e;
+        if (strcmp(argv[a], "-k") == 0) bad |= argInt(argv[++a], &opts.k);
+        else if (strcmp(argv[a], "-n") == 0) bad |= argInt(argv[++a], &opts.n_init);
+        else if (strcmp(argv[a], "-i") == 0) bad |= argInt(argv[++a], &opts.max_iter);
+        else if (strcmp(argv[a], "-s") == 0) {
+            opts.seed = strtoull(argv[++a], &e, 10);
+            bad |= (e == argv[a] || *e != '\0') ? -1 : 0;
+        } else if (strcmp(argv[a], "-j") == 0) bad |= argInt(argv[++a], &opts.nthreads);
+        else if (strcmp(argv[a], "-f") == 0) bad |= argInt(argv[++a], &width);
+        else if (strcmp(argv[a], "-l") == 0) label_file = argv[++a];
+        else if (strcmp(argv[a], "-b") == 0) bad |= argInt(argv[++a], &batch);
+        else break;
+    }
+    if (bad || a >= argc || argv[a][0] == '-' || opts.k < 1 || opts.k > KMEANS_MAX_K
+        || (stream && (table || width > 1))) {
+        fprintf(stderr, "usage: %s [-k clusters] [-n n_init] [-i max_iter] [-s seed] [-j threads] [-f width]"
+                        " [-l labels] [-t] [-m] [-b batch] <input filename> [column ...]\n", argv[0]);
+        return 1;
+    }
+    const char *filename = argv[a++];
+
+    // columns, by d[] index or by table header name
+    char names[KMEANS_MAX_COLS][TABLE_NAME_LEN];
+    int cols[FLOAT_DATA] = { DAT0, DAT1 };
+    int ncols = 0;
+    for (; a < argc && ncols < KMEANS_MAX_COLS; a++) {
+        if (table) {
+            names[ncols][0] = '\0';
+            strncat(names[ncols++], argv[a], TABLE_NAME_LEN - 1);
+        } else {
+            int c;
+            if (argInt(argv[a], &c) != 0 || c < 0 || c >= FLOAT_DATA || ncols == FLOAT_DATA) {
+                fprintf(stderr, "column %s out of range 0..%d\n", argv[a], FLOAT_DATA-1);
+                return 1;
+            }
+            cols[ncols++] = c;
+        }
+    }
+    if (ncols == 0) {
+        ncols = table ? 5 : 2;
+        for (int c = 0; table && c < ncols; c++)
+            sprintf(names[c], "x%d", c);
+    }
+    for (int c = 0; !table && c < ncols; c++) {
+        if (cols[c] == DAT0) strcpy(names[c], "foF2");
+        else if (cols[c] == DAT1) strcpy(names[c], "hmF2");
+        else sprintf(names[c], "d[%d]", cols[c]);
+    }
+    if (stream)
+        return streamCluster(filename, cols, ncols, names, &opts, batch, label_file);
+
+    // features, column major
+    float *col[KMEANS_MAX_COLS] = { NULL };
+    struct temporal_series ts;
+    temporalSeriesInit(&ts, 0);
+    int rows;
+    if (table) {
+        rows = readTable(filename, names, ncols, col);
+    } else {
+        rows = temporalReadSeries(&ts, filename, cols, ncols);
+        if (rows >= 0 && temporalSeriesSort(&ts) != 0)
+            rows = -1;
+        for (int c = 0; rows >= 0 && c < ncols; c++)
+            col[c] = ts.col[c];
+    }
+    if (rows < 0) {
+        fprintf(stderr, "Cannot read file ");
+        perror(filename);
+        return 1;
+    }
+    if (rows < opts.k) {
+        fprintf(stderr, "%s: %d rows, fewer than %d clusters\n", filename, rows, opts.k);
+        return 1;
+    }
+
+    // median filter first, the clusters of the filtered values
+    if (width > 1) {
+        float *ftr[KMEANS_MAX_COLS];
+        int status = 0;
+        for (int c = 0; c < ncols; c++) {
+            ftr[c] = malloc(rows * sizeof(float));
+            if (!ftr[c]) status = -1;
+        }
+        if (status == 0)
+            status = medianFilterChannels((const float *const *)col, ftr, ncols, rows, width);
+        if (status != 0) {
+            fprintf(stderr, "median filter: out of memory\n");
+            return 1;
+        }
+        for (int c = 0; c < ncols; c++) {
+            memcpy(col[c], ftr[c], rows * sizeof(float));
+            free(ftr[c]);
+        }
+    }
+
+    float mean[KMEANS_MAX_COLS], sd[KMEANS_MAX_COLS];
+    kmeansScale(col, ncols, rows, mean, sd);
+
+    struct kmeans_data x = { rows, ncols, { NULL } };
+    for (int c = 0; c < ncols; c++)
+        x.col[c] = col[c];
+    int *label = malloc(rows * sizeof(int));
+    struct kmeans_model model;
+    clock_t t0 = clock();
+    if (!label || kmeansRun(&x, &opts, &model, label) != 0) {
+        fprintf(stderr, "k-means: out of memory for %d rows\n", rows);
+        return 1;
+    }
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    printf("%d rows, %d columns, k %d, best of %d runs: inertia %.6g after %d iterations (%.3f s cpu)\n",
+           rows, ncols, model.k, opts.n_init, model.inertia, model.iter, secs);
+    printClusters(&model, names, ncols, mean, sd);
+
+    int status = 0;
+    if (label_file) {
+        FILE *fp = fopen(label_file, "w");
+        for (int i = 0; fp && i < rows; i++)
+            fprintf(fp, "%d\n", label[i]);
+        if (!fp || fclose(fp) != 0) {
+            perror(label_file);
+            status = 1;
+        }
+    }
+
+    free(label);
+    if (table) {
+        for (int c = 0; c < ncols; c++)
+            free(col[c]);
+    }
+    temporalSeriesFree(&ts);
+    return status;
+}
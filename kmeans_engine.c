@@ -0,0 +1,949 @@
+/*
+    Program: k-means clustering engine, see kmeans_engine.h
+
+             The points are cut into chunks of KMEANS_CHUNK blocks.  A pass
+             (assignment, or the final labels) runs the chunks on the
+             threads, chunk j on thread j % nthreads, and each chunk keeps
+             its own partial sums; they are added in chunk order after the
+             pass, so the result does not depend on the thread count.
+
+             Hamerly: u[i] >= distance of point i to its centre, l[i] <=
+             distance to any other centre, s[c] half the distance from
+             centre c to the nearest other one.  A point with
+             u[i] <= max(s[a[i]], l[i]) keeps its centre.  After the centres
+             move by p[c], u[i] grows by p[a[i]] and l[i] shrinks by the
+             largest move of the other centres.  The assignment pass keeps
+             the centre sums up to date from the points that changed.
+
+             based on: https://en.wikipedia.org/wiki/K-means%2B%2B
+                       G. Hamerly, Making k-means even faster, SDM 2010
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "kmeans_engine.h"
+
+#define KMEANS_CHUNK 16         // blocks per chunk, the unit of the partial sums
+
+// partial sums of one chunk in a pass
+struct km_part
+{
+    double sum[KMEANS_MAX_K][KMEANS_MAX_COLS];  // assignment: change of the centre sums
+    long n[KMEANS_MAX_K];
+    long changed;
+    double inertia;                             // labels pass
+};
+
+struct km_state
+{
+    const struct kmeans_data *x;
+    int k;
+    int nd;
+    float c[KMEANS_MAX_K][KMEANS_MAX_COLS];     // centres
+    float s[KMEANS_MAX_K];                      // half distance to the nearest other centre
+    float p[KMEANS_MAX_K];                      // move of the centres in the last update
+    int pfar, first;                            // centre that moved most, first pass of a run
+    float pmax, pnext;                          // its move, the largest move of the others
+    int *a;                                     // centre of each point
+    float *u, *l;                               // Hamerly bounds
+    int nchunk;
+    struct km_part *part;
+    double sum[KMEANS_MAX_K][KMEANS_MAX_COLS];  // centre sums
+    long n[KMEANS_MAX_K];
+};
+
+typedef void (*km_pass)(struct km_state *st, int chunk);
+
+struct km_worker
+{
+    struct km_state *st;
+    km_pass fn;
+    int t, nt;
+};
+
+/*
+Function: rngNext, rngUniform
+          splitmix64 generator, uniform in [0, 1)
+
+return: uint64_t , double
+*/
+static uint64_t rngNext(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rngUniform(uint64_t *s) {
+    return (rngNext(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+Function: kmeansDefaultOpts
+          the KMeans(n_clusters=4) settings of the notebook: 10 runs,
+          300 iterations, tol 1e-4; seed 0 and a thread per CPU
+
+return: void
+*/
+void kmeansDefaultOpts(struct kmeans_opts *opts) {
+    opts->k = 4;
+    opts->n_init = 10;
+    opts->max_iter = 300;
+    opts->tol = 1e-4f;
+    opts->seed = 0;
+    opts->nthreads = 0;
+}
+
+/*
+Function: kmeansScale
+          standardize each column in place to mean 0 and standard
+          deviation 1, as sklearn.preprocessing.scale (population
+          deviation, a constant column is only centred)
+          mean, sd: per column, to map centres back (may be NULL)
+
+return: int , 0 on success, -1 if there are no rows
+*/
+int kmeansScale(float *const col[], int ncols, int rows, float mean[], float sd[]) {
+    if (rows < 1)
+        return -1;
+    for (int d = 0; d < ncols; d++) {
+        float *v = col[d];
+        double m = 0., q = 0.;
+        for (int i = 0; i < rows; i++)
+            m += v[i];
+        m /= rows;
+        for (int i = 0; i < rows; i++)
+            q += (v[i] - m) * (v[i] - m);
+        double s = sqrt(q / rows);
+        if (!(s > 0.))
+            s = 1.;
+        float fm = (float)m, fs = (float)(1. / s);
+        for (int i = 0; i < rows; i++)
+            v[i] = (v[i] - fm) * fs;
+        if (mean)
+            mean[d] = fm;
+        if (sd)
+            sd[d] = (float)s;
+    }
+    return 0;
+}
+
+/*
+Function: blockDist
+          squared distances of points i0 .. i0+n-1 to the k centres,
+          d2[c][j] for point i0+j, column by column over the block
+
+return: void
+*/
+static void blockDist(const struct kmeans_data *x, int i0, int n, const float c[][KMEANS_MAX_COLS], int k,
+                      float d2[][KMEANS_BLOCK]) {
+    for (int m = 0; m < k; m++) {
+        float *restrict o = d2[m];
+        for (int j = 0; j < n; j++)
+            o[j] = 0.f;
+        for (int d = 0; d < x->ncols; d++) {
+            const float *restrict v = x->col[d] + i0;
+            float cd = c[m][d];
+            for (int j = 0; j < n; j++) {
+                float t = v[j] - cd;
+                o[j] += t * t;
+            }
+        }
+    }
+}
+
+/*
+Function: pointDist
+          squared distances of point i to the k centres into d2[c][j], the
+          same sums as blockDist
+
+return: void
+*/
+static void pointDist(const struct kmeans_data *x, int i, const float c[][KMEANS_MAX_COLS], int k,
+                      float d2[][KMEANS_BLOCK], int j) {
+    for (int m = 0; m < k; m++) {
+        float q = 0.f;
+        for (int d = 0; d < x->ncols; d++) {
+            float t = x->col[d][i] - c[m][d];
+            q += t * t;
+        }
+        d2[m][j] = q;
+    }
+}
+
+static float centreDist(const float *a, const float *b, int nd) {
+    float q = 0.f;
+    for (int d = 0; d < nd; d++)
+        q += (a[d] - b[d]) * (a[d] - b[d]);
+    return sqrtf(q);
+}
+
+static int chunkRows(const struct km_state *st, int chunk, int *i0) {
+    int n = KMEANS_CHUNK * KMEANS_BLOCK;
+    *i0 = chunk * n;
+    return (*i0 + n < st->x->rows) ? n : st->x->rows - *i0;
+}
+
+/*
+Function: assignChunk
+          Hamerly assignment of the points of a chunk: bounds moved with
+          the centres, then the points that fail the bound test get the
+          distances to all centres, a block at a time
+
+return: void
+*/
+static void assignChunk(struct km_state *st, int chunk) {
+    const struct kmeans_data *x = st->x;
+    struct km_part *pt = &st->part[chunk];
+    float d2[KMEANS_MAX_K][KMEANS_BLOCK];
+    char need[KMEANS_BLOCK];
+    int c0, rows = chunkRows(st, chunk, &c0);
+
+    memset(pt, 0, sizeof(*pt));
+    for (int b = 0; b < rows; b += KMEANS_BLOCK) {
+        int i0 = c0 + b, n = (rows - b < KMEANS_BLOCK) ? rows - b : KMEANS_BLOCK;
+        int nneed = 0;
+        for (int j = 0; j < n; j++) {
+            int i = i0 + j;
+            if (st->first) {
+                need[j] = 1;
+            } else {
+                int a = st->a[i];
+                st->u[i] += st->p[a];
+                st->l[i] -= (a == st->pfar) ? st->pnext : st->pmax;
+                float m = (st->s[a] > st->l[i]) ? st->s[a] : st->l[i];
+                need[j] = (st->u[i] > m);
+            }
+            nneed += need[j];
+        }
+        if (nneed == 0)
+            continue;
+
+        // few points left: their distances one by one, else the whole block
+        if (4 * nneed < n) {
+            for (int j = 0; j < n; j++) {
+                if (need[j])
+                    pointDist(x, i0 + j, (const float(*)[KMEANS_MAX_COLS])st->c, st->k, d2, j);
+            }
+        } else {
+            blockDist(x, i0, n, (const float(*)[KMEANS_MAX_COLS])st->c, st->k, d2);
+        }
+        for (int j = 0; j < n; j++) {
+            if (!need[j])
+                continue;
+            int i = i0 + j, best = 0;
+            float q1 = d2[0][j], q2 = FLT_MAX;
+            for (int m = 1; m < st->k; m++) {
+                if (d2[m][j] < q1) {
+                    q2 = q1;
+                    q1 = d2[m][j];
+                    best = m;
+                } else if (d2[m][j] < q2) {
+                    q2 = d2[m][j];
+                }
+            }
+            int a = st->first ? -1 : st->a[i];
+            if (best != a) {
+                for (int d = 0; d < x->ncols; d++) {
+                    double v = x->col[d][i];
+                    pt->sum[best][d] += v;
+                    if (a >= 0)
+                        pt->sum[a][d] -= v;
+                }
+                pt->n[best]++;
+                if (a >= 0)
+                    pt->n[a]--;
+                pt->changed++;
+                st->a[i] = best;
+            }
+            st->u[i] = sqrtf(q1);
+            st->l[i] = (st->k > 1) ? sqrtf(q2) : FLT_MAX;
+        }
+    }
+}
+
+/*
+Function: labelChunk
+          nearest centre and squared distance of every point of a chunk,
+          into st->a (if set), the counts and the inertia
+
+return: void
+*/
+static void labelChunk(struct km_state *st, int chunk) {
+    struct km_part *pt = &st->part[chunk];
+    float d2[KMEANS_MAX_K][KMEANS_BLOCK];
+    int c0, rows = chunkRows(st, chunk, &c0);
+
+    memset(pt, 0, sizeof(*pt));
+    for (int b = 0; b < rows; b += KMEANS_BLOCK) {
+        int i0 = c0 + b, n = (rows - b < KMEANS_BLOCK) ? rows - b : KMEANS_BLOCK;
+        blockDist(st->x, i0, n, (const float(*)[KMEANS_MAX_COLS])st->c, st->k, d2);
+        for (int j = 0; j < n; j++) {
+            int best = 0;
+            for (int m = 1; m < st->k; m++) {
+                if (d2[m][j] < d2[best][j])
+                    best = m;
+            }
+            if (st->a)
+                st->a[i0 + j] = best;
+            pt->n[best]++;
+            pt->inertia += d2[best][j];
+        }
+    }
+}
+
+static void *workerRun(void *arg) {
+    struct km_worker *w = arg;
+    for (int ch = w->t; ch < w->st->nchunk; ch += w->nt)
+        w->fn(w->st, ch);
+    return NULL;
+}
+
+/*
+Function: runPass
+          fn over all chunks on nt threads (the caller is one of them),
+          chunks of threads that cannot be started run in the caller
+
+return: void
+*/
+static void runPass(struct km_state *st, km_pass fn, int nt) {
+    struct km_worker w[KMEANS_MAX_THREADS];
+    pthread_t th[KMEANS_MAX_THREADS];
+    int started[KMEANS_MAX_THREADS];
+
+    if (st->nchunk == 0)
+        return;
+    if (nt > st->nchunk)
+        nt = st->nchunk;
+    if (nt < 1)
+        nt = 1;
+    for (int t = 0; t < nt; t++) {
+        w[t] = (struct km_worker){ st, fn, t, nt };
+        started[t] = (t > 0 && pthread_create(&th[t], NULL, workerRun, &w[t]) == 0);
+    }
+    workerRun(&w[0]);
+    for (int t = 1; t < nt; t++) {
+        if (started[t])
+            pthread_join(th[t], NULL);
+        else
+            workerRun(&w[t]);
+    }
+}
+
+/*
+Function: centreSpacing
+          s[c], half the distance from each centre to the nearest other
+
+return: void
+*/
+static void centreSpacing(struct km_state *st) {
+    for (int m = 0; m < st->k; m++)
+        st->s[m] = FLT_MAX;
+    for (int m = 0; m < st->k; m++) {
+        for (int o = m + 1; o < st->k; o++) {
+            float h = 0.5f * centreDist(st->c[m], st->c[o], st->nd);
+            if (h < st->s[m])
+                st->s[m] = h;
+            if (h < st->s[o])
+                st->s[o] = h;
+        }
+    }
+}
+
+/*
+Function: centreUpdate
+          add the partial sums of the pass in chunk order, move the
+          centres to the means (a centre left without points stays) and
+          record the moves for the bounds
+
+return: double , sum of the squared moves
+*/
+static double centreUpdate(struct km_state *st, long *changed) {
+    *changed = 0;
+    for (int ch = 0; ch < st->nchunk; ch++) {
+        const struct km_part *pt = &st->part[ch];
+        for (int m = 0; m < st->k; m++) {
+            st->n[m] += pt->n[m];
+            for (int d = 0; d < st->nd; d++)
+                st->sum[m][d] += pt->sum[m][d];
+        }
+        *changed += pt->changed;
+    }
+
+    double shift = 0.;
+    st->pfar = 0;
+    st->pmax = st->pnext = 0.f;
+    for (int m = 0; m < st->k; m++) {
+        float old[KMEANS_MAX_COLS];
+        memcpy(old, st->c[m], sizeof(old));
+        if (st->n[m] > 0) {
+            for (int d = 0; d < st->nd; d++)
+                st->c[m][d] = (float)(st->sum[m][d] / st->n[m]);
+        }
+        st->p[m] = centreDist(old, st->c[m], st->nd);
+        shift += (double)st->p[m] * st->p[m];
+        if (st->p[m] > st->pmax) {
+            st->pnext = st->pmax;
+            st->pmax = st->p[m];
+            st->pfar = m;
+        } else if (st->p[m] > st->pnext) {
+            st->pnext = st->p[m];
+        }
+    }
+    centreSpacing(st);
+    return shift;
+}
+
+/*
+Function: kmeansPlusPlus
+          greedy k-means++ seeding: the first centre a random point, each
+          next one the best of 2 + ln k points drawn with probability
+          proportional to the squared distance to the nearest centre so far
+          rng: generator state, advanced
+
+return: int , 0 on success, -1 on allocation failure or k out of range
+*/
+int kmeansPlusPlus(const struct kmeans_data *x, int k, uint64_t *rng, float centre[][KMEANS_MAX_COLS]) {
+    int n = x->rows;
+    if (k < 1 || k > KMEANS_MAX_K || n < 1)
+        return -1;
+    float *dmin = malloc(n * sizeof(float));
+    float *dtry = malloc(n * sizeof(float));
+    float *dbest = malloc(n * sizeof(float));
+    if (!dmin || !dtry || !dbest) {
+        free(dmin);
+        free(dtry);
+        free(dbest);
+        return -1;
+    }
+
+    float d2[1][KMEANS_BLOCK];
+    int pick = (int)(rngUniform(rng) * n);
+    for (int d = 0; d < x->ncols; d++)
+        centre[0][d] = x->col[d][pick];
+    double pot = 0.;
+    for (int i0 = 0; i0 < n; i0 += KMEANS_BLOCK) {
+        int nb = (n - i0 < KMEANS_BLOCK) ? n - i0 : KMEANS_BLOCK;
+        blockDist(x, i0, nb, (const float(*)[KMEANS_MAX_COLS])centre, 1, d2);
+        for (int j = 0; j < nb; j++) {
+            dmin[i0 + j] = d2[0][j];
+            pot += d2[0][j];
+        }
+    }
+
+    int trials = 2 + (int)log(k);
+    for (int m = 1; m < k; m++) {
+        double best = -1.;
+        int best_pick = 0;
+        for (int t = 0; t < trials; t++) {
+            // draw a point, P(i) = dmin[i] / pot
+            double r = rngUniform(rng) * pot, acc = 0.;
+            pick = n - 1;
+            for (int i = 0; i < n; i++) {
+                acc += dmin[i];
+                if (acc > r) {
+                    pick = i;
+                    break;
+                }
+            }
+            if (!(pot > 0.))
+                pick = (int)(rngUniform(rng) * n);
+
+            float cand[1][KMEANS_MAX_COLS];
+            for (int d = 0; d < x->ncols; d++)
+                cand[0][d] = x->col[d][pick];
+            double tpot = 0.;
+            for (int i0 = 0; i0 < n; i0 += KMEANS_BLOCK) {
+                int nb = (n - i0 < KMEANS_BLOCK) ? n - i0 : KMEANS_BLOCK;
+                blockDist(x, i0, nb, (const float(*)[KMEANS_MAX_COLS])cand, 1, d2);
+                for (int j = 0; j < nb; j++) {
+                    float q = (d2[0][j] < dmin[i0 + j]) ? d2[0][j] : dmin[i0 + j];
+                    dtry[i0 + j] = q;
+                    tpot += q;
+                }
+            }
+            if (best < 0. || tpot < best) {
+                best = tpot;
+                best_pick = pick;
+                float *t = dbest; dbest = dtry; dtry = t;
+            }
+        }
+        for (int d = 0; d < x->ncols; d++)
+            centre[m][d] = x->col[d][best_pick];
+        float *t = dmin; dmin = dbest; dbest = t;
+        pot = best;
+    }
+
+    free(dmin);
+    free(dtry);
+    free(dbest);
+    return 0;
+}
+
+static int threadCount(int nthreads) {
+#ifndef _WIN32
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (nthreads <= 0)
+        nthreads = 1;
+    return (nthreads > KMEANS_MAX_THREADS) ? KMEANS_MAX_THREADS : nthreads;
+}
+
+static int stateInit(struct km_state *st, const struct kmeans_data *x, int k, int hamerly) {
+    memset(st, 0, sizeof(*st));
+    st->x = x;
+    st->k = k;
+    st->nd = x->ncols;
+    st->nchunk = (x->rows + KMEANS_CHUNK * KMEANS_BLOCK - 1) / (KMEANS_CHUNK * KMEANS_BLOCK);
+    st->part = malloc(st->nchunk * sizeof(struct km_part));
+    if (hamerly) {
+        st->a = malloc(x->rows * sizeof(int));
+        st->u = malloc(x->rows * sizeof(float));
+        st->l = malloc(x->rows * sizeof(float));
+    }
+    return (st->part && (!hamerly || (st->a && st->u && st->l))) ? 0 : -1;
+}
+
+static void stateFree(struct km_state *st) {
+    free(st->part);
+    free(st->a);
+    free(st->u);
+    free(st->l);
+}
+
+/*
+Function: labelPass
+          labels (into st->a if set), counts and inertia for the centres
+          of st, into the model
+
+return: void
+*/
+static void labelPass(struct km_state *st, int nt, struct kmeans_model *model) {
+    runPass(st, labelChunk, nt);
+    model->k = st->k;
+    model->ncols = st->nd;
+    model->inertia = 0.;
+    memset(model->count, 0, sizeof(model->count));
+    for (int ch = 0; ch < st->nchunk; ch++) {
+        for (int m = 0; m < st->k; m++)
+            model->count[m] += st->part[ch].n[m];
+        model->inertia += st->part[ch].inertia;
+    }
+    memcpy(model->centre, st->c, sizeof(model->centre));
+}
+
+/*
+Function: kmeansRun
+          cluster the points of x into opts->k clusters, opts->n_init runs
+          from k-means++ seeds, the run of lowest inertia is kept
+          label: cluster of each point for the kept centres (may be NULL)
+
+return: int , 0 on success, -1 on bad options or allocation failure
+*/
+int kmeansRun(const struct kmeans_data *x, const struct kmeans_opts *opts, struct kmeans_model *model,
+              int label[]) {
+    int k = opts->k;
+    if (k < 1 || k > KMEANS_MAX_K || x->ncols < 1 || x->ncols > KMEANS_MAX_COLS || x->rows < k)
+        return -1;
+    int nt = threadCount(opts->nthreads);
+    struct km_state st;
+    if (stateInit(&st, x, k, 1) != 0) {
+        stateFree(&st);
+        return -1;
+    }
+
+    // tol is relative to the mean variance of the features
+    double var = 0.;
+    for (int d = 0; d < x->ncols; d++) {
+        double m = 0., q = 0.;
+        for (int i = 0; i < x->rows; i++)
+            m += x->col[d][i];
+        m /= x->rows;
+        for (int i = 0; i < x->rows; i++)
+            q += (x->col[d][i] - m) * (x->col[d][i] - m);
+        var += q / x->rows;
+    }
+    double tol = opts->tol * var / x->ncols;
+
+    uint64_t rng = opts->seed;
+    int status = 0;
+    model->inertia = -1.;
+    for (int run = 0; run < ((opts->n_init > 0) ? opts->n_init : 1); run++) {
+        if (kmeansPlusPlus(x, k, &rng, st.c) != 0) {
+            status = -1;
+            break;
+        }
+        memset(st.sum, 0, sizeof(st.sum));
+        memset(st.n, 0, sizeof(st.n));
+        centreSpacing(&st);
+        st.first = 1;
+
+        int it = 0;
+        while (it < opts->max_iter) {
+            runPass(&st, assignChunk, nt);
+            st.first = 0;
+            long changed;
+            double shift = centreUpdate(&st, &changed);
+            it++;
+            if (changed == 0 || shift <= tol)
+                break;
+        }
+
+        struct kmeans_model m;
+        labelPass(&st, nt, &m);
+        m.iter = it;
+        if (model->inertia < 0. || m.inertia < model->inertia) {
+            *model = m;
+            if (label)
+                memcpy(label, st.a, x->rows * sizeof(int));
+        }
+    }
+
+    stateFree(&st);
+    return status;
+}
+
+/*
+Function: kmeansPredict
+          nearest centre of the model for every point of x
+
+return: int , 0 on success, -1 on allocation failure or a model that
+        does not match x
+*/
+int kmeansPredict(const struct kmeans_data *x, const struct kmeans_model *model, int label[], int nthreads) {
+    if (model->ncols != x->ncols || model->k < 1 || model->k > KMEANS_MAX_K)
+        return -1;
+    struct km_state st;
+    if (stateInit(&st, x, model->k, 0) != 0) {
+        stateFree(&st);
+        return -1;
+    }
+    st.a = label;
+    memcpy(st.c, model->centre, sizeof(st.c));
+    runPass(&st, labelChunk, threadCount(nthreads));
+    st.a = NULL;
+    stateFree(&st);
+    return 0;
+}
+
+/*
+Function: kmeansStreamInit
+          empty stream of ncols columns, mini-batches of batch rows (<= 0:
+          KMEANS_BATCH); the first max(3 batch, 3 k) rows, rounded up to
+          whole batches, are kept for the seeding by kmeansRun() with the
+          n_init, max_iter, seed and threads of opts
+
+return: int , 0 on success, -1 on bad options or allocation failure
+*/
+int kmeansStreamInit(struct kmeans_stream *ks, const struct kmeans_opts *opts, int ncols, int batch) {
+    memset(ks, 0, sizeof(*ks));
+    if (opts->k < 1 || opts->k > KMEANS_MAX_K || ncols < 1 || ncols > KMEANS_MAX_COLS)
+        return -1;
+    ks->opts = *opts;
+    ks->ncols = ncols;
+    ks->batch = (batch > 0) ? batch : KMEANS_BATCH;
+    int init = (3 * ks->batch > 3 * opts->k) ? 3 * ks->batch : 3 * opts->k;
+    ks->init_rows = (init + ks->batch - 1) / ks->batch * ks->batch;
+
+    int status = 0;
+    for (int d = 0; d < ncols; d++) {
+        ks->init[d] = malloc(ks->init_rows * sizeof(float));
+        ks->xb[d] = malloc(ks->batch * sizeof(float));
+        ks->xs[d] = malloc(ks->batch * sizeof(float));
+        if (!ks->init[d] || !ks->xb[d] || !ks->xs[d])
+            status = -1;
+    }
+    ks->lab = malloc(ks->batch * sizeof(int));
+    if (!ks->lab)
+        status = -1;
+    if (status != 0)
+        kmeansStreamFree(ks);
+    return status;
+}
+
+/*
+Function: kmeansStreamFree
+
+return: void
+*/
+void kmeansStreamFree(struct kmeans_stream *ks) {
+    for (int d = 0; d < KMEANS_MAX_COLS; d++) {
+        free(ks->init[d]);
+        free(ks->xb[d]);
+        free(ks->xs[d]);
+        ks->init[d] = ks->xb[d] = ks->xs[d] = NULL;
+    }
+    free(ks->lab);
+    ks->lab = NULL;
+}
+
+/*
+Function: streamScale
+          reciprocal standard deviation of each column so far (1 for a
+          constant column, as kmeansScale)
+
+return: void
+*/
+static void streamScale(const struct kmeans_stream *ks, float isd[]) {
+    for (int d = 0; d < ks->ncols; d++) {
+        double s = (ks->rows > 0) ? sqrt(ks->m2[d] / ks->rows) : 0.;
+        isd[d] = (s > 0.) ? (float)(1. / s) : 1.f;
+    }
+}
+
+/*
+Function: streamNearest
+          standardize rows off .. off+n-1 of col (n <= batch) with the
+          running mean and deviation and give each the nearest centre in
+          ks->lab, a block at a time
+
+return: double , sum of the squared standardized distances
+*/
+static double streamNearest(struct kmeans_stream *ks, const float *const col[], int off, int n) {
+    float isd[KMEANS_MAX_COLS];
+    float c[KMEANS_MAX_K][KMEANS_MAX_COLS];
+    streamScale(ks, isd);
+    for (int d = 0; d < ks->ncols; d++) {
+        float m = (float)ks->mean[d], s = isd[d];
+        const float *v = col[d] + off;
+        float *restrict o = ks->xs[d];
+        for (int j = 0; j < n; j++)
+            o[j] = (v[j] - m) * s;
+        for (int q = 0; q < ks->opts.k; q++)
+            c[q][d] = (ks->centre[q][d] - m) * s;
+    }
+
+    struct kmeans_data x = { n, ks->ncols, { NULL } };
+    for (int d = 0; d < ks->ncols; d++)
+        x.col[d] = ks->xs[d];
+    float d2[KMEANS_MAX_K][KMEANS_BLOCK];
+    double inertia = 0.;
+    for (int i0 = 0; i0 < n; i0 += KMEANS_BLOCK) {
+        int nb = (n - i0 < KMEANS_BLOCK) ? n - i0 : KMEANS_BLOCK;
+        blockDist(&x, i0, nb, (const float(*)[KMEANS_MAX_COLS])c, ks->opts.k, d2);
+        for (int j = 0; j < nb; j++) {
+            int best = 0;
+            for (int q = 1; q < ks->opts.k; q++) {
+                if (d2[q][j] < d2[best][j])
+                    best = q;
+            }
+            ks->lab[i0 + j] = best;
+            inertia += d2[best][j];
+        }
+    }
+    return inertia;
+}
+
+/*
+Function: streamUpdate
+          one mini-batch step on rows off .. off+n-1 of col: nearest
+          centres, then each centre moves to the mean of all the rows it
+          was given so far
+
+return: void
+*/
+static void streamUpdate(struct kmeans_stream *ks, const float *const col[], int off, int n) {
+    double sum[KMEANS_MAX_K][KMEANS_MAX_COLS];
+    long cnt[KMEANS_MAX_K];
+    memset(sum, 0, sizeof(sum));
+    memset(cnt, 0, sizeof(cnt));
+
+    ks->inertia += streamNearest(ks, col, off, n);
+    for (int j = 0; j < n; j++) {
+        int q = ks->lab[j];
+        cnt[q]++;
+        for (int d = 0; d < ks->ncols; d++)
+            sum[q][d] += col[d][off + j];
+    }
+    for (int q = 0; q < ks->opts.k; q++) {
+        if (cnt[q] == 0)
+            continue;
+        long total = ks->count[q] + cnt[q];
+        for (int d = 0; d < ks->ncols; d++) {
+            double c = ks->centre[q][d];
+            ks->centre[q][d] = (float)(c + (sum[q][d] - cnt[q] * c) / total);
+        }
+        ks->count[q] = total;
+    }
+    ks->batches++;
+}
+
+/*
+Function: streamSeed
+          seeds from the kept rows: standardized with the statistics so
+          far and clustered by kmeansRun(), the centres taken back to the
+          units of the input; the kept rows are then the first batches
+
+return: int , 0 on success, -1 on allocation failure or fewer rows than
+        clusters
+*/
+static int streamSeed(struct kmeans_stream *ks) {
+    int n = ks->ninit, k = ks->opts.k;
+    if (n < k)
+        return -1;
+    float isd[KMEANS_MAX_COLS];
+    streamScale(ks, isd);
+
+    struct kmeans_data x = { n, ks->ncols, { NULL } };
+    float *sc[KMEANS_MAX_COLS] = { NULL };
+    int status = 0;
+    for (int d = 0; d < ks->ncols; d++) {
+        sc[d] = malloc(n * sizeof(float));
+        if (!sc[d]) {
+            status = -1;
+            continue;
+        }
+        float m = (float)ks->mean[d];
+        for (int i = 0; i < n; i++)
+            sc[d][i] = (ks->init[d][i] - m) * isd[d];
+        x.col[d] = sc[d];
+    }
+    struct kmeans_model model;
+    if (status == 0)
+        status = kmeansRun(&x, &ks->opts, &model, NULL);
+    for (int d = 0; d < ks->ncols; d++)
+        free(sc[d]);
+    if (status != 0)
+        return -1;
+
+    for (int q = 0; q < k; q++) {
+        for (int d = 0; d < ks->ncols; d++)
+            ks->centre[q][d] = model.centre[q][d] / isd[d] + (float)ks->mean[d];
+    }
+    ks->seeded = 1;
+    for (int off = 0; off < n; off += ks->batch)
+        streamUpdate(ks, (const float *const *)ks->init, off, (n - off < ks->batch) ? n - off : ks->batch);
+    for (int d = 0; d < ks->ncols; d++) {
+        free(ks->init[d]);
+        ks->init[d] = NULL;
+    }
+    return 0;
+}
+
+/*
+Function: streamBatch
+          the pending batch is complete: into the running statistics,
+          then kept for the seeding or used for a mini-batch step
+
+return: int , 0 on success, -1 if the seeding fails
+*/
+static int streamBatch(struct kmeans_stream *ks) {
+    int n = ks->nb;
+    ks->nb = 0;
+    if (n == 0)
+        return 0;
+    for (int d = 0; d < ks->ncols; d++) {
+        const float *v = ks->xb[d];
+        double m = 0., q = 0.;
+        for (int j = 0; j < n; j++)
+            m += v[j];
+        m /= n;
+        for (int j = 0; j < n; j++)
+            q += (v[j] - m) * (v[j] - m);
+        double delta = m - ks->mean[d], total = (double)ks->rows + n;
+        ks->mean[d] += delta * n / total;
+        ks->m2[d] += q + delta * delta * ks->rows * n / total;
+    }
+    ks->rows += n;
+
+    if (ks->seeded) {
+        streamUpdate(ks, (const float *const *)ks->xb, 0, n);
+        return 0;
+    }
+    for (int d = 0; d < ks->ncols; d++)
+        memcpy(ks->init[d] + ks->ninit, ks->xb[d], n * sizeof(float));
+    ks->ninit += n;
+    return (ks->ninit < ks->init_rows) ? 0 : streamSeed(ks);
+}
+
+/*
+Function: kmeansStreamAdd
+          add rows of the ncols columns col[], in any chunk size, as they
+          are read
+
+return: int , 0 on success, -1 if the seeding fails
+*/
+int kmeansStreamAdd(struct kmeans_stream *ks, const float *const col[], int rows) {
+    for (int r = 0; r < rows; ) {
+        int n = ks->batch - ks->nb;
+        if (n > rows - r)
+            n = rows - r;
+        for (int d = 0; d < ks->ncols; d++)
+            memcpy(ks->xb[d] + ks->nb, col[d] + r, n * sizeof(float));
+        ks->nb += n;
+        r += n;
+        if (ks->nb == ks->batch && streamBatch(ks) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+Function: kmeansStreamModel
+          after the last rows: the partial batch is used (and the seeding
+          done if there were fewer rows than init), the centres are given
+          standardized with the final statistics, the counts and inertia
+          are those of the mini-batch steps, iter the number of batches
+          mean, sd: per column, to map centres back (may be NULL)
+
+return: int , 0 on success, -1 if there are fewer rows than clusters
+*/
+int kmeansStreamModel(struct kmeans_stream *ks, struct kmeans_model *model, float mean[], float sd[]) {
+    if (streamBatch(ks) != 0 || (!ks->seeded && streamSeed(ks) != 0))
+        return -1;
+    float isd[KMEANS_MAX_COLS];
+    streamScale(ks, isd);
+
+    memset(model, 0, sizeof(*model));
+    model->k = ks->opts.k;
+    model->ncols = ks->ncols;
+    for (int q = 0; q < ks->opts.k; q++) {
+        for (int d = 0; d < ks->ncols; d++)
+            model->centre[q][d] = (ks->centre[q][d] - (float)ks->mean[d]) * isd[d];
+        model->count[q] = ks->count[q];
+    }
+    model->inertia = ks->inertia;
+    model->iter = (int)ks->batches;
+    for (int d = 0; d < ks->ncols; d++) {
+        if (mean)
+            mean[d] = (float)ks->mean[d];
+        if (sd)
+            sd[d] = 1.f / isd[d];
+    }
+    return 0;
+}
+
+/*
+Function: kmeansStreamLabel
+          second pass, after kmeansStreamModel(): the nearest final centre
+          of each of rows of col[] (label may be NULL), added to
+          model->count and model->inertia (zero them before the first
+          chunk for the figures of the final centres)
+
+return: int , 0 on success, -1 before kmeansStreamModel()
+*/
+int kmeansStreamLabel(struct kmeans_stream *ks, const float *const col[], int rows, int label[],
+                      struct kmeans_model *model) {
+    if (!ks->seeded)
+        return -1;
+    for (int off = 0; off < rows; off += ks->batch) {
+        int n = (rows - off < ks->batch) ? rows - off : ks->batch;
+        model->inertia += streamNearest(ks, col, off, n);
+        for (int j = 0; j < n; j++) {
+            model->count[ks->lab[j]]++;
+            if (label)
+                label[off + j] = ks->lab[j];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+    k-means clustering engine for the feature columns of the temporal data,
+    the clustering stage of rd_sci_clustering.ipynb without the notebook.
+
+    The features are a column major matrix: col[d][i] is feature d of
+    point i, the layout of a temporal_series, so the filtered columns are
+    clustered where they are.  kmeansScale() standardizes them in place
+    as sklearn.preprocessing.scale.
+
+    kmeansRun() seeds with greedy k-means++ (as sklearn: 2 + ln k trial
+    centres per step, the one lowering the inertia most is kept), then
+    runs Lloyd iterations with Hamerly's bounds: per point an upper bound
+    on the distance to its centre and a lower bound on the distance to
+    any other, so the points whose centre cannot have changed are skipped.
+    Distances are computed a block of KMEANS_BLOCK points at a time over
+    the contiguous columns, which the compiler vectorizes; the points are
+    split over threads for the assignment and the centre sums.
+
+    The best of n_init runs (lowest inertia) is kept.  Runs are
+    repeatable: the same seed gives the same centres for any number of
+    threads.
+
+    kmeans_stream is the out of core mode for archives that do not fit in
+    memory: rows are added as they are read (any chunk size) and cut into
+    mini-batches of a fixed size.  The mean and variance of the columns
+    are running ones (Chan's update of Welford's sums), and the centres
+    are kept in the units of the input: the mean cancels in a distance,
+    so only the scale of the features moves as the rows come in.  The
+    first init rows are kept and clustered by kmeansRun() for the seeds,
+    then every batch is assigned to the nearest centres and each centre
+    moves to the mean of all rows it was given so far (Sculley's
+    mini-batch k-means, decreasing rate 1/count).  The memory is the
+    init rows and one batch, whatever the number of rows.
+    kmeansStreamLabel() is the optional second pass: labels, counts and
+    inertia of the final centres, a chunk at a time.
+*/
+
+#ifndef KMEANS_ENGINE_H
+#define KMEANS_ENGINE_H
+
+#include <stdint.h>
+
+#define KMEANS_MAX_COLS 16      // features per point
+#define KMEANS_MAX_K 64         // clusters
+#define KMEANS_BLOCK 256        // points per distance block
+#define KMEANS_MAX_THREADS 64
+#define KMEANS_BATCH 1024       // rows per mini-batch, default as sklearn MiniBatchKMeans
+
+// n points of ncols features, column major
+struct kmeans_data
+{
+    int rows;
+    int ncols;
+    const float *col[KMEANS_MAX_COLS];
+};
+
+struct kmeans_opts
+{
+    int k;                      // clusters, default 4 as the notebook
+    int n_init;                 // runs from different seeds, default 10
+    int max_iter;               // per run, default 300
+    float tol;                  // centre shift (squared, summed) relative to the mean feature variance
+    uint64_t seed;
+    int nthreads;               // <= 0: one per online CPU
+};
+
+struct kmeans_model
+{
+    int k;
+    int ncols;
+    float centre[KMEANS_MAX_K][KMEANS_MAX_COLS];
+    long count[KMEANS_MAX_K];   // points per cluster
+    double inertia;             // sum of squared distances to the centres
+    int iter;                   // iterations of the kept run
+};
+
+// out of core mini-batch k-means, rows added in chunks
+struct kmeans_stream
+{
+    struct kmeans_opts opts;
+    int ncols;
+    int batch;                  // rows per mini-batch
+    long rows;                  // rows added so far
+    long batches;               // mini-batches used for the centres
+    double mean[KMEANS_MAX_COLS];
+    double m2[KMEANS_MAX_COLS]; // sum of squared deviations from the mean
+    int seeded;
+    float centre[KMEANS_MAX_K][KMEANS_MAX_COLS];   // in the units of the input
+    long count[KMEANS_MAX_K];   // rows given to each centre so far
+    double inertia;             // standardized, each row against the centres it met
+    int init_rows, ninit;       // rows kept for the seeding, kept so far
+    float *init[KMEANS_MAX_COLS];
+    int nb;                     // rows in the pending batch
+    float *xb[KMEANS_MAX_COLS]; // pending batch, in the units of the input
+    float *xs[KMEANS_MAX_COLS]; // a batch standardized
+    int *lab;
+};
+
+void kmeansDefaultOpts(struct kmeans_opts *opts);
+int kmeansScale(float *const col[], int ncols, int rows, float mean[], float sd[]);
+int kmeansPlusPlus(const struct kmeans_data *x, int k, uint64_t *rng, float centre[][KMEANS_MAX_COLS]);
+int kmeansRun(const struct kmeans_data *x, const struct kmeans_opts *opts, struct kmeans_model *model,
+              int label[]);
+int kmeansPredict(const struct kmeans_data *x, const struct kmeans_model *model, int label[], int nthreads);
+
+int kmeansStreamInit(struct kmeans_stream *ks, const struct kmeans_opts *opts, int ncols, int batch);
+int kmeansStreamAdd(struct kmeans_stream *ks, const float *const col[], int rows);
+int kmeansStreamModel(struct kmeans_stream *ks, struct kmeans_model *model, float mean[], float sd[]);
+int kmeansStreamLabel(struct kmeans_stream *ks, const float *const col[], int rows, int label[],
+                      struct kmeans_model *model);
+void kmeansStreamFree(struct kmeans_stream *ks);
+
+#endif
@@ -0,0 +1,231 @@
+/*
+    Program: benchmark of the median filter stages, parsing, sorting and
+             filtering, on generated fixtures so runs can be compared
+             between builds and releases.
+
+             The fixtures are data files in the median_filter input format
+             (header, blank row, data rows), written from a fixed seed: the
+             same rows on every run.  A share of the rows is out of time
+             order so the sort has work to do.
+
+    usage:   median_bench [-t seconds] [-d directory] [-k]
+             -t  least time per case, default 0.2 s
+             -d  where the fixtures are written, default .
+             -k  keep the fixture files
+
+    Output:  tab separated on stdout, a header line then one line per case
+               suite case rows width iters seconds ns_per_row
+             seconds is the total over iters runs of the case
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "median_engine.h"
+#include "temporal_reader.h"
+
+#define BENCH_MIN_S 0.2         // least time per case
+#define BENCH_SEED 20211014u    // fixture seed
+#define BENCH_SHUFFLE 50        // one row in BENCH_SHUFFLE is out of order
+
+static const int bench_rows[] = { 10000, 100000, 400000 };
+static const int bench_width[] = { 3, 5, 31, 301, 3601 };
+
+static double min_time = BENCH_MIN_S;
+
+/*
+Function: benchNow
+          monotonic time in seconds
+
+return: double
+*/
+static double benchNow(void) {
+    struct timespec ts;
+#ifndef _WIN32
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t lcg;
+
+static uint32_t benchRand(void) {
+    lcg = lcg * 1664525u + 1013904223u;
+    return lcg >> 8;
+}
+
+/*
+Function: writeFixture
+          rows of 15 minute ionosonde data from 2000.01.01, foF2 and hmF2
+          like values in d[0] and d[5], noise in the other columns
+
+return: int , 0 on success, -1 if the file cannot be written
+*/
+static int writeFixture(const char *filename, int rows) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return -1;
+
+    lcg = BENCH_SEED;
+    fprintf(fp, "Date Doy Time CS foF2 foF1 foE foEs h'Es hmF2 hmF1 hmE B0 B1 TEC\n\n");
+    for (int r = 0; r < rows; r++) {
+        int t = r;
+        if (benchRand() % BENCH_SHUFFLE == 0)
+            t = (int)(benchRand() % rows);
+        int day = t / 96, q = t % 96;
+        int y = 2000 + day / 360, m = day / 30 % 12 + 1, d = day % 30 + 1;
+        fprintf(fp, "%04d.%02d.%02d %03d %02d:%02d:00 %d", y, m, d, day % 365 + 1, q / 4, q % 4 * 15,
+                (int)(benchRand() % 100));
+        for (int c = 0; c < FLOAT_DATA; c++) {
+            float v = (c == 0) ? 5.f + (benchRand() % 500) / 100.f
+                    : (c == 5) ? 250.f + (benchRand() % 1000) / 10.f
+                    : (benchRand() % 10000) / 100.f;
+            fprintf(fp, " %.3f", v);
+        }
+        fputc('\n', fp);
+    }
+    return (fclose(fp) == 0) ? 0 : -1;
+}
+
+static void report(const char *suite, const char *name, int rows, int width, int iters, double s) {
+    printf("%s\t%s\t%d\t%d\t%d\t%.6f\t%.3f\n", suite, name, rows, width, iters, s, s / iters / rows * 1e9);
+    fflush(stdout);
+}
+
+/*
+Function: copySeries
+          dst as a copy of the rows of src (dst allocated like src)
+
+return: int , 0 on success, -1 out of memory
+*/
+static int copySeries(struct temporal_series *dst, const struct temporal_series *src) {
+    temporalSeriesInit(dst, src->ncols);
+    dst->rows = dst->cap = src->rows;
+    dst->key = malloc(src->rows * sizeof(int64_t));
+    if (!dst->key)
+        return -1;
+    memcpy(dst->key, src->key, src->rows * sizeof(int64_t));
+    for (int c = 0; c < src->ncols; c++) {
+        dst->col[c] = malloc(src->rows * sizeof(float));
+        if (!dst->col[c])
+            return -1;
+        memcpy(dst->col[c], src->col[c], src->rows * sizeof(float));
+    }
+    return 0;
+}
+
+/*
+Function: benchFile
+          parse, sort and filter one fixture
+
+return: int , 0 on success, -1 on failure
+*/
+static int benchFile(const char *filename, int rows) {
+    const int cols[2] = { 0, 5 };
+    struct temporal_series ts;
+    int iters = 0;
+    double s = 0.;
+
+    // parse: the whole file into a series, 2 of the 11 columns
+    do {
+        double t0 = benchNow();
+        if (temporalReadSeries(&ts, filename, cols, 2) != rows)
+            return -1;
+        s += benchNow() - t0;
+        iters++;
+        if (s < min_time)
+            temporalSeriesFree(&ts);
+    } while (s < min_time);
+    report("median", "parse", rows, 0, iters, s);
+
+    // sort: out of order rows as read, then already sorted rows
+    struct temporal_series raw;
+    if (copySeries(&raw, &ts) != 0)
+        return -1;
+    for (int sorted = 0; sorted < 2; sorted++) {
+        iters = 0;
+        s = 0.;
+        do {
+            struct temporal_series work;
+            if (copySeries(&work, sorted ? &ts : &raw) != 0)
+                return -1;
+            double t0 = benchNow();
+            if (temporalSeriesSort(&work) != 0)
+                return -1;
+            s += benchNow() - t0;
+            iters++;
+            if (!sorted && iters == 1) {
+                temporalSeriesFree(&ts);
+                ts = work;              // the sorted rows for the next cases
+            } else {
+                temporalSeriesFree(&work);
+            }
+        } while (s < min_time);
+        report("median", sorted ? "sort_sorted" : "sort_shuffled", rows, 0, iters, s);
+    }
+    temporalSeriesFree(&raw);
+
+    // filter: both channels in one sweep at each width
+    float *ftr[2] = { malloc(rows * sizeof(float)), malloc(rows * sizeof(float)) };
+    if (!ftr[0] || !ftr[1])
+        return -1;
+    for (size_t w = 0; w < sizeof(bench_width) / sizeof(bench_width[0]); w++) {
+        iters = 0;
+        s = 0.;
+        do {
+            double t0 = benchNow();
+            if (medianFilterChannels((const float *const *)ts.col, ftr, 2, rows, bench_width[w]) != 0)
+                return -1;
+            s += benchNow() - t0;
+            iters++;
+        } while (s < min_time);
+        report("median", "filter", rows, bench_width[w], iters, s);
+    }
+    free(ftr[0]);
+    free(ftr[1]);
+    temporalSeriesFree(&ts);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    const char *dir = ".";
+    int keep = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+            min_time = atof(argv[++a]);
+        else if (strcmp(argv[a], "-d") == 0 && a + 1 < argc)
+            dir = argv[++a];
+        else if (strcmp(argv[a], "-k") == 0)
+            keep = 1;
+        else {
+            fprintf(stderr, "usage: %s [-t seconds] [-d directory] [-k]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("suite\tcase\trows\twidth\titers\tseconds\tns_per_row\n");
+    int status = 0;
+    for (size_t i = 0; status == 0 && i < sizeof(bench_rows) / sizeof(bench_rows[0]); i++) {
+        char filename[FILE_NAME_LEN];
+        snprintf(filename, sizeof(filename), "%s/bench_%d.dat", dir, bench_rows[i]);
+        if (writeFixture(filename, bench_rows[i]) != 0) {
+            fprintf(stderr, "cannot write fixture ");
+            perror(filename);
+            return 1;
+        }
+        if (benchFile(filename, bench_rows[i]) != 0) {
+            fprintf(stderr, "benchmark of %s failed\n", filename);
+            status = 1;
+        }
+        if (!keep)
+            remove(filename);
+    }
+
+    return status;
+}
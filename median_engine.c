@@ -0,0 +1,312 @@
+/*
+    Program: streaming median engine, see median_engine.h
+
+             The window replaces its oldest sample in place: the new value
+             takes over the ring slot (and its heap position) of the sample
+             leaving the window, it is sifted within its own heap, and the
+             two heap tops are swapped once if they are out of order.
+             Heap sizes never change once the window is full.
+
+             based on: https://en.wikipedia.org/wiki/Median_filter
+                       two heap running median (mediator), O(log w) per sample
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "median_engine.h"
+
+#define LO_SIZE(mw) ((mw)->edge + 1)
+#define HI_SIZE(mw) ((mw)->width - (mw)->edge - 1)
+
+/*
+Function: loValue, hiValue
+          value of the sample at heap index i
+
+return: float
+*/
+static float loValue(const struct median_window *mw, int i) {
+    return mw->vals[mw->lo[i]];
+}
+
+static float hiValue(const struct median_window *mw, int i) {
+    return mw->vals[mw->hi[i]];
+}
+
+/*
+Function: loSwap, hiSwap
+          swap two heap entries and keep the slot positions current
+
+return: void
+*/
+static void loSwap(struct median_window *mw, int i, int j) {
+    int t = mw->lo[i]; mw->lo[i] = mw->lo[j]; mw->lo[j] = t;
+    mw->slot_pos[mw->lo[i]] = i;
+    mw->slot_pos[mw->lo[j]] = j;
+}
+
+static void hiSwap(struct median_window *mw, int i, int j) {
+    int t = mw->hi[i]; mw->hi[i] = mw->hi[j]; mw->hi[j] = t;
+    mw->slot_pos[mw->hi[i]] = -1 - i;
+    mw->slot_pos[mw->hi[j]] = -1 - j;
+}
+
+/*
+Function: loSift, hiSift
+          restore the max-heap (lo) or min-heap (hi) order from index i,
+          moving the entry up then down as required
+          n: number of entries currently in the heap
+
+return: void
+*/
+static void loSift(struct median_window *mw, int i, int n) {
+    while (i > 0 && loValue(mw, (i - 1) / 2) < loValue(mw, i)) {
+        loSwap(mw, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && loValue(mw, c) < loValue(mw, c + 1)) c++;
+        if (!(loValue(mw, i) < loValue(mw, c))) break;
+        loSwap(mw, i, c);
+        i = c;
+    }
+}
+
+static void hiSift(struct median_window *mw, int i, int n) {
+    while (i > 0 && hiValue(mw, i) < hiValue(mw, (i - 1) / 2)) {
+        hiSwap(mw, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && hiValue(mw, c + 1) < hiValue(mw, c)) c++;
+        if (!(hiValue(mw, c) < hiValue(mw, i))) break;
+        hiSwap(mw, i, c);
+        i = c;
+    }
+}
+
+/*
+Function: balanceTops
+          the only sample that can be out of place is the one just written,
+          a single exchange of the heap tops puts it on the correct side
+
+return: void
+*/
+static void balanceTops(struct median_window *mw, int nlo, int nhi) {
+    if (nlo == 0 || nhi == 0) return;
+    if (!(hiValue(mw, 0) < loValue(mw, 0))) return;
+
+    int a = mw->lo[0];
+    int b = mw->hi[0];
+    mw->lo[0] = b; mw->slot_pos[b] = 0;
+    mw->hi[0] = a; mw->slot_pos[a] = -1;
+    loSift(mw, 0, nlo);
+    hiSift(mw, 0, nhi);
+}
+
+/*
+Function: medianWindowInit
+          allocate a window of the given width (width >= 1)
+
+return: int , 0 on success, -1 on bad width or allocation failure
+*/
+int medianWindowInit(struct median_window *mw, int width) {
+    memset(mw, 0, sizeof(*mw));
+    if (width < 1) return -1;
+
+    mw->width = width;
+    mw->edge = width / 2;                               // rounded down
+    mw->vals = malloc(width * sizeof(float));
+    mw->slot_pos = malloc(width * sizeof(int));
+    mw->lo = malloc(LO_SIZE(mw) * sizeof(int));
+    mw->hi = malloc((HI_SIZE(mw) > 0 ? HI_SIZE(mw) : 1) * sizeof(int));
+    if (!mw->vals || !mw->slot_pos || !mw->lo || !mw->hi) {
+        medianWindowFree(mw);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Function: medianWindowFree
+
+return: void
+*/
+void medianWindowFree(struct median_window *mw) {
+    free(mw->vals);
+    free(mw->slot_pos);
+    free(mw->lo);
+    free(mw->hi);
+    memset(mw, 0, sizeof(*mw));
+}
+
+/*
+Function: medianWindowReset
+          empty the window, keeping its width and storage
+
+return: void
+*/
+void medianWindowReset(struct median_window *mw) {
+    mw->count = 0;
+    mw->oldest = 0;
+}
+
+/*
+Function: medianWindowPush
+          add a sample, once the window is full the oldest sample is dropped
+
+return: int , 1 when the window is full (median valid), 0 while filling
+*/
+int medianWindowPush(struct median_window *mw, float val) {
+    int nlo = LO_SIZE(mw);
+    int nhi = HI_SIZE(mw);
+
+    if (mw->count < mw->width) {
+        // filling: lo takes the first edge+1 samples, hi the rest
+        int slot = mw->count;
+        mw->vals[slot] = val;
+        if (slot < nlo) {
+            mw->lo[slot] = slot; mw->slot_pos[slot] = slot;
+            loSift(mw, slot, slot + 1);
+            balanceTops(mw, slot + 1, 0);
+        } else {
+            int i = slot - nlo;
+            mw->hi[i] = slot; mw->slot_pos[slot] = -1 - i;
+            hiSift(mw, i, i + 1);
+            balanceTops(mw, nlo, i + 1);
+        }
+        mw->count++;
+        return mw->count == mw->width;
+    }
+
+    // full: the new sample takes over the slot of the oldest one
+    int slot = mw->oldest;
+    int p = mw->slot_pos[slot];
+    mw->vals[slot] = val;
+    if (p >= 0)
+        loSift(mw, p, nlo);
+    else
+        hiSift(mw, -1 - p, nhi);
+    balanceTops(mw, nlo, nhi);
+
+    mw->oldest = (mw->oldest + 1 == mw->width) ? 0 : mw->oldest + 1;
+    return 1;
+}
+
+/*
+Function: medianWindowValue
+          the median of the window, only meaningful when the window is full
+
+return: float
+*/
+float medianWindowValue(const struct median_window *mw) {
+    return loValue(mw, 0);
+}
+
+/*
+Function: median3, median5
+          sorting network medians for the small fixed widths
+          same result as picking the middle of the qsort-ed window
+          written with min/max only (no branches) so loops over them vectorize
+
+return: float
+*/
+#define MINF(a, b) (((b) < (a)) ? (b) : (a))
+#define MAXF(a, b) (((a) < (b)) ? (b) : (a))
+
+float median3(float a, float b, float c) {
+    return MAXF(MINF(a, b), MINF(MAXF(a, b), c));
+}
+
+float median5(float a, float b, float c, float d, float e) {
+    float f = MAXF(MINF(a, b), MINF(c, d));             // drops the smallest of a..d
+    float g = MINF(MAXF(a, b), MAXF(c, d));             // drops the largest of a..d
+    return median3(e, f, g);
+}
+
+/*
+Function: medianFilterChannels
+          one dimensional median filter of several channels in one sweep
+          dat[ch][], ftr[ch][]: nch input and output columns of end samples
+          boundary samples (first and last edge samples) are copied unfiltered,
+          as in the original medianFilter
+
+          The columns are walked together block by block (MEDIAN_BLOCK samples),
+          so each block of every channel is filtered while it is in cache.
+          Widths 3 and 5 run the min/max networks over the contiguous samples
+          of a column, which the compiler turns into SIMD min/max.
+          Other widths keep one streaming window per channel.
+
+return: int , 0 on success, -1 on allocation failure
+*/
+int medianFilterChannels(const float *const dat[], float *const ftr[], int nch, int end, int width) {
+    int edge = width / 2;
+    int last = end - edge;                              // first sample not filtered
+    struct median_window *mw = NULL;
+
+    if (width >= 2 && end >= width && width != 3 && width != 5) {
+        mw = calloc(nch, sizeof(struct median_window));
+        if (!mw)
+            return -1;
+        for (int ch = 0; ch < nch; ch++) {
+            if (medianWindowInit(&mw[ch], width) != 0) {
+                while (ch-- > 0)
+                    medianWindowFree(&mw[ch]);
+                free(mw);
+                return -1;
+            }
+            for (int j = 0; j < width - 1; j++)
+                medianWindowPush(&mw[ch], dat[ch][j]);
+        }
+    }
+
+    for (int b0 = 0; b0 < end; b0 += MEDIAN_BLOCK) {
+        int b1 = (b0 + MEDIAN_BLOCK < end) ? b0 + MEDIAN_BLOCK : end;
+        for (int ch = 0; ch < nch; ch++) {
+            const float *restrict d = dat[ch];
+            float *restrict f = ftr[ch];
+            for (int i = b0; i < b1; i++)
+                f[i] = d[i];
+            if (width < 2 || end < width)
+                continue;
+
+            int i0 = (b0 > edge) ? b0 : edge;
+            int i1 = (b1 < last) ? b1 : last;
+            if (width == 3) {
+                for (int i = i0; i < i1; i++)
+                    f[i] = median3(d[i - 1], d[i], d[i + 1]);
+            } else if (width == 5) {
+                for (int i = i0; i < i1; i++)
+                    f[i] = median5(d[i - 2], d[i - 1], d[i], d[i + 1], d[i + 2]);
+            } else {
+                for (int i = i0; i < i1; i++) {
+                    medianWindowPush(&mw[ch], d[i + width - 1 - edge]);
+                    f[i] = medianWindowValue(&mw[ch]);
+                }
+            }
+        }
+    }
+
+    if (mw) {
+        for (int ch = 0; ch < nch; ch++)
+            medianWindowFree(&mw[ch]);
+        free(mw);
+    }
+
+    return 0;
+}
+
+/*
+Function: medianFilterWidth
+          one dimensional median filter of dat[] into ftr[] for any window width,
+          the single channel case of medianFilterChannels
+
+return: int , 0 on success, -1 on allocation failure
+*/
+int medianFilterWidth(const float dat[], float ftr[], int end, int width) {
+    return medianFilterChannels(&dat, &ftr, 1, end, width);
+}
@@ -0,0 +1,44 @@
+/*
+    Streaming median engine for the one dimensional median filter.
+
+    A window of fixed width slides over the data one sample at a time.
+    The window is held as two heaps over a ring buffer of the samples:
+      lo : max-heap with the (edge+1) smallest samples, its top is the median
+      hi : min-heap with the remaining (width-edge-1) samples
+    where edge = floor(width/2), i.e. the same rank that was picked from the
+    qsort-ed window.  Replacing the oldest sample costs O(log width).
+
+    For the small widths (3, 5) a sorting network is used instead.
+    Any number of channels (columns) can be filtered in one sweep.
+*/
+
+#ifndef MEDIAN_ENGINE_H
+#define MEDIAN_ENGINE_H
+
+#define MEDIAN_BLOCK 2048       // samples per channel filtered per block of the sweep
+
+struct median_window
+{
+    int width;                  // window width
+    int edge;                   // rank of the median in the sorted window
+    int count;                  // samples pushed so far
+    int oldest;                 // ring slot holding the oldest sample
+    float *vals;                // ring buffer of the samples in the window
+    int *slot_pos;              // heap index for each slot, >=0 lo, <0 hi (-1 - index)
+    int *lo;                    // max-heap of ring slots, size edge+1
+    int *hi;                    // min-heap of ring slots, size width-edge-1
+};
+
+int medianWindowInit(struct median_window *mw, int width);
+void medianWindowFree(struct median_window *mw);
+void medianWindowReset(struct median_window *mw);
+int medianWindowPush(struct median_window *mw, float val);
+float medianWindowValue(const struct median_window *mw);
+
+float median3(float a, float b, float c);
+float median5(float a, float b, float c, float d, float e);
+
+int medianFilterChannels(const float *const dat[], float *const ftr[], int nch, int end, int width);
+int medianFilterWidth(const float dat[], float ftr[], int end, int width);
+
+#endif
@@ -1,267 +1,324 @@
-/*
-    Program: median filtering on electron density and peak density.
-             Using a simple one dimensional median filtering algorithm,
-             each of electron density and peak density is plotted as an
-             unfiltered data against its filtered data.
-
-             Input file requires inspection to determine row of relevant data,
-             set as NUM_ROWS.  Using GNU Plot with default settings.
-
-    Input:   data file (header, blank row, data rows)
-    Output:  plots of electron density & peak density
-*/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-
-#define NUM_ROWS 467            // inspect input file to determine num of rows of relevant data (way to detect w/o inspection???)
-#define FILE_NAME_LEN 256       // standard file name length
-#define FLOAT_DATA 11
-#define CHAR_DATE 11            // includes null terminate
-#define CHAR_TIME 9
-#define INT_SYM 6               // 3 digit symbol with parentheses + null
-#define READ_BUF 1024           // read buffer size, default = 1024
-#define DAT0 0                  // index location first data requested from provided file
-#define DAT1 5                  // index location second data requested from provided file
-#define MEDIAN_WIN_GUESS 3      // guess for the window size for the median filter range (?????)
-                                //  smallest value to start but algorithm has no adjustment for larger guess
-
-struct temporal
-{
-    char date[CHAR_DATE];
-    char dig[INT_SYM];
-    char timestmp[CHAR_TIME];
-    int x;
-    float d[FLOAT_DATA];
-};
-
-/*
-Taken from: https://en.cppreference.com/w/c/algorithm/qsort
-            qsort for int
-
-Function: compareVals
-          to sort input types in floats
-
-return: int
-*/
-int compareVals(const void* a, const void* b)
-{
-    float arg1 = *(const float*)a;
-    float arg2 = *(const float*)b;
- 
-    if (arg1 < arg2) return -1;
-    if (arg1 > arg2) return 1;
-    return 0;
- 
-    // return (arg1 > arg2) - (arg1 < arg2); // possible shortcut
-    // return arg1 - arg2; // erroneous shortcut (fails if INT_MIN is present)
-}
-
-/*
-Function: sortDate
-          to sort a struct on its member
-          upon return, the struct is updated post sort
-
-return: int , status of strcmp
-*/
-int sortDate(const void *a, const void *b) {
-    struct temporal *aa = (struct temporal *)a;
-    struct temporal *bb = (struct temporal *)b;
-    return strcmp( aa->date, bb->date );            // low level equivalent: (*aa).timestmp, (*bb).timestmp
-}
-
-/*
-Function: filterPlot
-          using gnu plot to plot the data to show the filtered portion over original
-
-return: int
-*/
-int filterPlot(float dat[], float ftr[], int end, char *title) {
-
-    FILE *gnuplot = popen("gnuplot -persistent", "w");
-    if (!gnuplot) {
-        perror("popen");
-        printf(" gnu launch error ");
-    }
-    // default options used -- data cannot use int
-    fprintf(gnuplot, "set title '%s'\n", title);
-    fprintf(gnuplot, "plot '-' u 1:2 t 'unfiltered' w lp lt 0, '' u 1:2 t 'filtered' w lines lt 2\n");
-    for (int i = 0; i < end; ++i) {
-        fprintf(gnuplot,"%f %f\n", (float)(i), dat[i]);
-    }
-    fprintf(gnuplot, "e\n");
-    for (int i = 0; i < end; ++i) {
-        fprintf(gnuplot,"%f %f\n", (float)(i), ftr[i]);
-    }
-    fprintf(gnuplot, "e\n");
-
-    fflush(gnuplot);
-    pclose(gnuplot);
-    
-    return 0;
-}
-
-/*
-Function: medianFilter
-          computes a median filter using one dimensional method
-          plots the unfiltered data against the filtered data
-          based on: https://en.wikipedia.org/wiki/Median_filter
-
-          For the one dimensional filter, starting with an input array:
-            A[] = {7,8,2,1,3,6,5,7,4}   : dat[] -corresponding var in function
-            window size = 3             : window_width
-                                        : standard min default
-            X[] = med(7,8,2)            : outputPixelValue -corresponding var in function
-            qsort(2,7,8)
-            X[] = {7}                   : continue for all length of array
-
-          Boundary conditions:
-            first index                 : edge -corresponding var in function
-                                        : min value
-            total array length          : end -corresponding var in function
-
-return: int
-*/
-int medianFilter(float dat[], int end, char *filter_name) {
-    int window_width = MEDIAN_WIN_GUESS;                    // the guess width of the filter window
-    float outputPixelValue[end];                            // new filtered data
-    // transfer data - for filtering
-    for (int k=0; k<end; k++) {
-        outputPixelValue[k] = dat[k]; 
-    }
-    float window[window_width];                             // hold the values in the window in question
-    int edge = floor(window_width / 2);                     // rounded down
-    int k;
-    for (int i=edge; i<(end-edge); i++) {
-        k = 0;
-        for (int j=0; j<window_width; j++) {
-            window[k++] = dat[i + j - edge];
-        }
-        qsort(window, window_width, sizeof(float), compareVals);
-        outputPixelValue[i] = window[edge];
-    }
-
-    // call the gnu plot
-    filterPlot(dat, outputPixelValue, end, filter_name);
-
-    return 0;
-}
-
-/*
-Function: readInputFile
-
-reads the input file with the following assumptions:
-input file inspected for header structure and number of rows for data to be read
-header and blank line known to exist as first 2 rows so discarded
-the rest of rows are data rows
-
-the data is stored in a struct
-
-return: int , value of last row
-*/
-int readInputFile(struct temporal *temporals, char *argv[]) {
-    // read input file
-    char filename[FILE_NAME_LEN];
-    filename[0] = '\0';
-    strcpy( filename, argv[1] );
-
-    FILE *p;
-    p = fopen(filename, "r");
-    if (!p) {
-        fprintf(stderr,"Cannot read file");
-        perror(NULL);
-        exit(1);
-    }
-
-    // upon inspection, input file has header then blank row
-    // discard both
-    // does not account missing header so it will treat a line as any other
-    printf("\n-------------------------------------------------------------------\n");
-    printf("Initiate read file: discard header and blank line (from inspection)");
-    printf("\n-------------------------------------------------------------------\n");
-    char header[READ_BUF]; header[0] = '\0';
-    fgets(header, sizeof(header), p);
-    // blank line
-    fgets(header, sizeof(header), p);
-
-    // read the file until EOF, i tracks the number of lines
-    // read the file and transfer data to memory then close file
-    char buf[READ_BUF];
-    int i=0;
-    while (fgets(buf,sizeof(buf),p) != NULL ) {
-        strcpy(temporals[i].date, strtok(buf, " "));
-        strcpy(temporals[i].dig, strtok(NULL, " "));
-        strcpy(temporals[i].timestmp, strtok(NULL, " "));
-        temporals[i].x = atoi(strtok(NULL, " "));
-        temporals[i].d[0] = atof(strtok(NULL, " \n"));
-        temporals[i].d[1] = atof(strtok(NULL, " \n"));
-        temporals[i].d[2] = atof(strtok(NULL, " \n"));
-        temporals[i].d[3] = atof(strtok(NULL, " \n"));
-        temporals[i].d[4] = atof(strtok(NULL, " \n"));
-        temporals[i].d[5] = atof(strtok(NULL, " \n"));
-        temporals[i].d[6] = atof(strtok(NULL, " \n"));
-        temporals[i].d[7] = atof(strtok(NULL, " \n"));
-        temporals[i].d[8] = atof(strtok(NULL, " \n"));
-        temporals[i].d[9] = atof(strtok(NULL, " \n"));
-        temporals[i].d[10] = atof(strtok(NULL, " \n"));
-        i++;
-    }
-    fclose(p);
-    int end = i;          // holding the last index with data, i holds total after the post incr
-    
-    return end;
-}
-
-/*
-Function: main
-          to read the data, sort by date/time, compute median filter on fof2 & hmf2
-
-return: int
-*/
-int main(int argc, char *argv[]) {
-
-    struct temporal temporals[NUM_ROWS];
-
-    int end = readInputFile(temporals, argv);
-
-    // ***  sort data, compute data ***
-
-    // the date already starts at the largest number (year) to lower number
-    // time starts at largest number(hour) to lower numbers
-    // taking advantage of this format, combine date/time to make it continuous char for qsort
-    // store in new struct
-    struct new_temporal {
-        char date_t[CHAR_DATE+CHAR_TIME];
-        float fof2; float hmf2;
-    } date_time[end];                           // num of rows
-
-    // storing date/time for other uses, i.e. debugging, inspection, verification
-    // main data: fof2 & hmf2 columns
-    for (int k=0; k<end; k++) {
-        strcpy(date_time[k].date_t,temporals[k].date);
-        strcat(date_time[k].date_t,".");
-        strcat(date_time[k].date_t,temporals[k].timestmp);
-        date_time[k].fof2 = temporals[k].d[DAT0];
-        date_time[k].hmf2 = temporals[k].d[DAT1];
-    }
-
-    // using built in C , stdlib.h, qsort 
-    qsort(date_time, end, sizeof(struct new_temporal), sortDate);
-
-    // compute: median filter for fof2, hmf2
-    float fof2[end]; float hmf2[end];
-    // prep for the generic median filter function, pass only intended data for filtering
-    for (int k=0; k<end; k++) {
-        fof2[k] = date_time[k].fof2;
-        hmf2[k] = date_time[k].hmf2; 
-    }
-    // compute median filter
-    medianFilter(fof2, end, "foF2");
-    medianFilter(hmf2, end, "hmF2");
-
-    printf("\n");
-
-    return 0;
-}
\ No newline at end of file
+/*
+    Program: median filtering on electron density and peak density.
+             Using a simple one dimensional median filtering algorithm,
+             each of electron density and peak density is plotted as an
+             unfiltered data against its filtered data.
+
+             The input file is read in one pass by the streaming reader
+             (temporal_reader.c), no row count is needed in advance.
+             Output goes to a sink: GNU Plot with default settings,
+             or a csv / binary file, or nothing for batch runs.
+
+             -p runs a directory or manifest of station files at once on
+             the filter pipeline (filter_pipeline.c), each station's csv /
+             binary output into the sink directory, the same bytes as a
+             run on that file alone.
+
+    Input:   data file (header, blank row, data rows)
+    Output:  plots of electron density & peak density (or files)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include "median_engine.h"
+#include "temporal_reader.h"
+#include "filter_sink.h"
+#include "filter_pipeline.h"
+
+#define DAT0 0                  // index location first data requested from provided file
+#define DAT1 5                  // index location second data requested from provided file
+#define MEDIAN_WIN_GUESS 3      // guess for the window size for the median filter range (?????)
+                                //  smallest value to start but algorithm has no adjustment for larger guess
+
+/*
+Function: medianFilter
+          computes a median filter using one dimensional method
+          the filtered data is returned in ftr[], plotting or writing it
+          out is left to the output sink (filter_sink.c)
+          based on: https://en.wikipedia.org/wiki/Median_filter
+
+          For the one dimensional filter, starting with an input array:
+            A[] = {7,8,2,1,3,6,5,7,4}   : dat[] -corresponding var in function
+            window size = 3             : window_width
+                                        : standard min default
+            X[] = med(7,8,2)            : outputPixelValue -corresponding var in function
+            sorted(2,7,8)
+            X[] = {7}                   : continue for all length of array
+
+          The window is kept by the streaming median engine (median_engine.c),
+          O(log w) per sample, so the window can be widened to hours of data.
+          All nch channels (columns) are filtered in a single sweep.
+
+          Boundary conditions:
+            first index                 : edge -corresponding var in function
+                                        : min value
+            total array length          : end -corresponding var in function
+
+return: int
+*/
+int medianFilter(float *dat[], float *ftr[], int nch, int end) {
+    int window_width = MEDIAN_WIN_GUESS;                    // the guess width of the filter window
+
+    // all channels in one sweep
+    if (medianFilterChannels((const float *const *)dat, ftr, nch, end, window_width) != 0) {
+        fprintf(stderr, "median filter: out of memory\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+Function: readInputFile
+
+reads the input file with the following assumptions:
+header and blank line known to exist as first 2 rows so discarded
+the rest of rows are data rows, any number of them
+
+only the requested columns d[cols[]] are kept, in the series
+
+return: int , number of rows
+*/
+int readInputFile(struct temporal_series *ts, char *argv[], const int cols[], int ncols) {
+    // read input file
+    char filename[FILE_NAME_LEN];
+    filename[0] = '\0';
+    strncat( filename, argv[1], FILE_NAME_LEN-1 );
+
+    printf("\n-------------------------------------------------------------------\n");
+    printf("Initiate read file: discard header and blank line (from inspection)");
+    printf("\n-------------------------------------------------------------------\n");
+
+    int end = temporalReadSeries(ts, filename, cols, ncols);
+    if (end < 0) {
+        fprintf(stderr,"Cannot read file ");
+        perror(filename);
+        exit(1);
+    }
+
+    return end;
+}
+
+/*
+Function: runPipeline
+          -p: all the station files of a directory or manifest on the
+          pipeline, sink none, csv:<dir> or bin:<dir>
+
+return: int , 0 if every station was filtered and written
+*/
+int runPipeline(const char *path, const char *sink_spec, const int cols[], int ncols, char names[][16],
+                int nthreads, int depth) {
+    struct pipeline_opts o;
+    memset(&o, 0, sizeof(o));
+    o.nthreads = nthreads;
+    o.depth = depth;
+    o.width = MEDIAN_WIN_GUESS;
+    const char *colon = strchr(sink_spec, ':');
+    if (strcmp(sink_spec, "none") == 0) {
+        o.sink = "none";
+    } else if (colon && (strncmp(sink_spec, "csv:", 4) == 0 || strncmp(sink_spec, "bin:", 4) == 0)) {
+        o.sink = (sink_spec[0] == 'c') ? "csv" : "bin";
+        o.out_dir = colon + 1;
+    } else {
+        fprintf(stderr, "-p writes to none, csv:<directory> or bin:<directory>, not %s\n", sink_spec);
+        return 1;
+    }
+    o.ncols = ncols;
+    for (int c = 0; c < ncols; c++) {
+        o.cols[c] = cols[c];
+        strcpy(o.names[c], names[c]);
+    }
+
+    char **inputs;
+    int n = pipelineList(path, &inputs);
+    if (n < 0) {
+        fprintf(stderr, "Cannot read directory or manifest ");
+        perror(path);
+        return 1;
+    }
+    struct pipeline_station *st = calloc(n > 0 ? n : 1, sizeof(struct pipeline_station));
+    if (!st) {
+        fprintf(stderr, "out of memory for %d stations\n", n);
+        return 1;
+    }
+    for (int i = 0; i < n; i++)
+        st[i].input = inputs[i];
+
+    struct timespec t0, t1;
+    timespec_get(&t0, TIME_UTC);
+    int status = pipelineRun(&o, st, n);
+    timespec_get(&t1, TIME_UTC);
+
+    long rows = 0;
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        if (st[i].status == 0) {
+            printf("%s: %d rows%s%s\n", st[i].input, st[i].rows, st[i].output[0] ? " -> " : "", st[i].output);
+            rows += st[i].rows;
+        } else {
+            printf("%s: failed\n", st[i].input);
+            failed++;
+        }
+    }
+    printf("%d stations (%d failed), %ld rows in %.3f s\n", n, failed, rows,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9);
+
+    free(st);
+    pipelineListFree(inputs, n);
+    return (status == 0) ? 0 : 1;
+}
+
+/*
+Function: argInt
+          a whole argument as a decimal int, strtol with nothing left over
+
+return: int , 0 on success, -1 if it is not a number or out of int range
+*/
+static int argInt(const char *s, int *v) {
+    char *e;
+    errno = 0;
+    long x = strtol(s, &e, 10);
+    if (e == s || *e != '\0' || errno == ERANGE || x < INT_MIN || x > INT_MAX)
+        return -1;
+    *v = (int)x;
+    return 0;
+}
+
+/*
+Function: main
+          to read the data, sort by date/time, compute median filter on the
+          requested columns, fof2 & hmf2 (d[DAT0], d[DAT1]) by default
+
+          usage: median_filter [-o sink] <input filename> [column ...]
+                 median_filter -p [-j threads] [-q depth] [-o sink] <directory|manifest> [column ...]
+                 sink: gnuplot (default), none, csv:<file>, bin:<file>;
+                       with -p none (default), csv:<dir>, bin:<dir>
+                 column: index 0..FLOAT_DATA-1 into d[]
+                 -j  pipeline threads (-p only, > 0), default one per CPU
+                 -q  stations in flight (-p only, > 0), default 2 per thread
+
+return: int
+*/
+int main(int argc, char *argv[]) {
+
+    const char *sink_spec = NULL, *jarg = NULL, *qarg = NULL;
+    int pipeline = 0, nthreads = 0, depth = 0;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-p") == 0) {
+            pipeline = 1;
+            argv += 1;
+            argc -= 1;
+            continue;
+        }
+        if (strcmp(argv[1], "-o") == 0) sink_spec = argv[2];
+        else if (strcmp(argv[1], "-j") == 0) jarg = argv[2];
+        else if (strcmp(argv[1], "-q") == 0) qarg = argv[2];
+        else break;
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: %s [-o gnuplot|none|csv:<file>|bin:<file>] <input filename> [column ...]\n"
+                        "       %s -p [-j threads] [-q depth] [-o none|csv:<dir>|bin:<dir>] <directory|manifest>"
+                        " [column ...]\n", argv[0], argv[0]);
+        return 1;
+    }
+    if ((jarg || qarg) && !pipeline) {
+        fprintf(stderr, "-j and -q go with -p\n");
+        return 1;
+    }
+    if ((jarg && (argInt(jarg, &nthreads) != 0 || nthreads <= 0))
+        || (qarg && (argInt(qarg, &depth) != 0 || depth <= 0))) {
+        fprintf(stderr, "-j threads and -q depth must be positive numbers\n");
+        return 1;
+    }
+    if (!sink_spec)
+        sink_spec = pipeline ? "none" : "gnuplot";
+
+    int cols[FLOAT_DATA] = { DAT0, DAT1 };
+    int ncols = 2;
+    if (argc - 2 > FLOAT_DATA) {
+        fprintf(stderr, "%d columns given, at most %d\n", argc - 2, FLOAT_DATA);
+        return 1;
+    }
+    if (argc > 2) {
+        ncols = 0;
+        for (int a = 2; a < argc; a++) {
+            int c;
+            if (argInt(argv[a], &c) != 0 || c < 0 || c >= FLOAT_DATA) {
+                fprintf(stderr, "column %s out of range 0..%d\n", argv[a], FLOAT_DATA-1);
+                return 1;
+            }
+            cols[ncols++] = c;
+        }
+    }
+
+    // channel names, columns are passed as is to the median filter
+    char names[FLOAT_DATA][16];
+    char *filter_names[FLOAT_DATA];
+    for (int c = 0; c < ncols; c++) {
+        if (cols[c] == DAT0) strcpy(names[c], "foF2");
+        else if (cols[c] == DAT1) strcpy(names[c], "hmF2");
+        else sprintf(names[c], "d[%d]", cols[c]);
+        filter_names[c] = names[c];
+    }
+
+    if (pipeline)
+        return runPipeline(argv[1], sink_spec, cols, ncols, names, nthreads, depth);
+
+    struct temporal_series ts;
+    int end = readInputFile(&ts, argv, cols, ncols);
+
+    // ***  sort data, compute data ***
+
+    // the reader packed date/time into one integer key per row
+    // sort the columns by it (usually already in order, then no sort)
+    if (temporalSeriesSort(&ts) != 0) {
+        fprintf(stderr, "out of memory sorting %d rows\n", end);
+        exit(1);
+    }
+
+    // opened once the arguments and the input are good, no early return
+    // leaves a gnuplot pipe or a part written file behind
+    struct filter_sink sink;
+    if (sinkOpen(&sink, sink_spec) != 0) {
+        fprintf(stderr, "cannot open output %s\n", sink_spec);
+        temporalSeriesFree(&ts);
+        return 1;
+    }
+
+    // compute median filter
+    float *ftr[FLOAT_DATA] = { NULL };
+    int status = 0;
+    for (int c = 0; c < ncols; c++) {
+        ftr[c] = malloc((end > 0 ? end : 1) * sizeof(float));
+        if (!ftr[c]) status = -1;
+    }
+    if (status == 0)
+        status = medianFilter(ts.col, ftr, ncols, end);
+    else
+        fprintf(stderr, "out of memory for %d rows\n", end);
+
+    // hand the unfiltered and filtered data to the sink (plot, file, ...)
+    for (int c = 0; status == 0 && c < ncols; c++)
+        if (sinkWrite(&sink, filter_names[c], ts.col[c], ftr[c], end) != 0) {
+            fprintf(stderr, "cannot write %s to %s\n", filter_names[c], sink_spec);
+            status = -1;
+        }
+    if (sinkClose(&sink) != 0)
+        status = -1;
+
+    for (int c = 0; c < ncols; c++)
+        free(ftr[c]);
+    temporalSeriesFree(&ts);
+
+    printf("\n");
+
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/*
+    Program: median filter of a live station feed.
+             Each run reads the rows appended to the data file since the
+             last run, filters them with the window state kept in the
+             state file (median_online.c) and appends the samples whose
+             window is complete to the output, so a new sweep costs its
+             own rows, not the whole history.
+
+             The rows may come slightly out of time order, up to slack
+             rows are held back and put in order; an older row is dropped
+             and counted.  -f ends the feed: the held back and the last
+             rows are given out and the state file is removed.
+
+             At the end of the feed the output holds the same rows as
+             median_filter -o csv: on the whole file, but sample by
+             sample (the channels of a sample together) where
+             median_filter writes channel by channel; the rows sorted by
+             channel (in the order of the columns) and index are its
+             bytes.
+
+    usage:   median_live [-w width] [-s slack] [-f] [-o file] -S state <input filename> [column ...]
+             -w  median window, default 3 (as median_filter)
+             -s  rows held back for reordering, default 0
+             -o  csv output, appended (header if new), default stdout
+             -S  state file, made on the first run
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "median_online.h"
+#include "temporal_reader.h"
+
+#define DAT0 0                  // as median_filter
+#define DAT1 5
+#define LIVE_MAGIC "MEDLIVE"    // 8 bytes with the null
+
+// state file: this, then the median_online state
+struct live_head
+{
+    char magic[8];
+    int64_t offset;             // next row of the data file (temporalReaderTell)
+    int32_t ncols;
+    int32_t cols[FLOAT_DATA];
+};
+
+/*
+Function: loadState
+          the state of the earlier runs, if there were any
+
+return: int , 1 loaded, 0 no state file, -1 not a valid state
+*/
+static int loadState(const char *path, struct live_head *h, struct median_online *mo) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    int status = (fread(h, sizeof(*h), 1, fp) == 1 && memcmp(h->magic, LIVE_MAGIC, sizeof(h->magic)) == 0
+                  && h->ncols > 0 && h->ncols <= FLOAT_DATA && medianOnlineLoad(mo, fp) == 0) ? 1 : -1;
+    if (status == 1 && mo->nch != h->ncols) {
+        medianOnlineFree(mo);
+        status = -1;
+    }
+    fclose(fp);
+    return status;
+}
+
+/*
+Function: saveState
+          written aside and renamed over the old state, a run stopped
+          half way leaves the old state whole
+
+return: int , 0 on success, -1 on error
+*/
+static int saveState(const char *path, const struct live_head *h, const struct median_online *mo) {
+    char tmp[FILE_NAME_LEN + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+        return -1;
+    int status = (fwrite(h, sizeof(*h), 1, fp) == 1 && medianOnlineSave(mo, fp) == 0) ? 0 : -1;
+    if (fclose(fp) != 0)
+        status = -1;
+    if (status == 0 && rename(tmp, path) != 0)
+        status = -1;
+    if (status != 0)
+        remove(tmp);
+    return status;
+}
+
+/*
+Function: argInt
+          a whole argument as a decimal int, strtol with nothing left over
+
+return: int , 0 on success, -1 if it is not a number or out of int range
+*/
+static int argInt(const char *s, int *v) {
+    char *e;
+    errno = 0;
+    long x = strtol(s, &e, 10);
+    if (e == s || *e != '\0' || errno == ERANGE || x < INT_MIN || x > INT_MAX)
+        return -1;
+    *v = (int)x;
+    return 0;
+}
+
+static void writeSamples(FILE *out, char names[][16], int nch, const struct median_sample s[], int n) {
+    for (int k = 0; k < n; k++)
+        for (int c = 0; c < nch; c++)
+            fprintf(out, "%s,%ld,%g,%g\n", names[c], s[k].index, s[k].val[c], s[k].ftr[c]);
+}
+
+int main(int argc, char *argv[]) {
+
+    int width = 3, slack = 0, flush = 0, bad = 0;
+    const char *out_path = NULL, *state_path = NULL;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-f") == 0) {
+            flush = 1;
+            argv += 1;
+            argc -= 1;
+            continue;
+        }
+        if (strcmp(argv[1], "-w") == 0) bad |= argInt(argv[2], &width);
+        else if (strcmp(argv[1], "-s") == 0) bad |= argInt(argv[2], &slack);
+        else if (strcmp(argv[1], "-o") == 0) out_path = argv[2];
+        else if (strcmp(argv[1], "-S") == 0) state_path = argv[2];
+        else break;
+        argv += 2;
+        argc -= 2;
+    }
+    if (bad || argc < 2 || argv[1][0] == '-' || !state_path || strlen(state_path) >= FILE_NAME_LEN) {
+        fprintf(stderr, "usage: median_live [-w width] [-s slack] [-f] [-o file] -S state <input filename> [column ...]\n");
+        return 1;
+    }
+
+    struct live_head h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LIVE_MAGIC, sizeof(h.magic));
+    h.cols[0] = DAT0;
+    h.cols[1] = DAT1;
+    h.ncols = 2;
+    if (argc > 2) {
+        h.ncols = 0;
+        for (int a = 2; a < argc && h.ncols < FLOAT_DATA; a++) {
+            int c;
+            if (argInt(argv[a], &c) != 0 || c < 0 || c >= FLOAT_DATA) {
+                fprintf(stderr, "column %s out of range 0..%d\n", argv[a], FLOAT_DATA-1);
+                return 1;
+            }
+            h.cols[h.ncols++] = c;
+        }
+    }
+
+    // the state fixes the columns, window and slack of the feed
+    struct median_online mo;
+    struct live_head saved;
+    int loaded = loadState(state_path, &saved, &mo);
+    if (loaded < 0) {
+        fprintf(stderr, "%s is not a median_live state\n", state_path);
+        return 1;
+    }
+    if (loaded) {
+        if (saved.ncols != h.ncols || memcmp(saved.cols, h.cols, h.ncols * sizeof(int32_t)) != 0
+            || mo.width != width || mo.slack != slack) {
+            fprintf(stderr, "%s holds another feed (columns, -w or -s differ)\n", state_path);
+            medianOnlineFree(&mo);
+            return 1;
+        }
+        h.offset = saved.offset;
+    } else if (medianOnlineInit(&mo, width, slack, h.ncols) != 0) {
+        fprintf(stderr, "bad window %d or slack %d\n", width, slack);
+        return 1;
+    }
+
+    char names[FLOAT_DATA][16];
+    int cols[FLOAT_DATA];
+    for (int c = 0; c < h.ncols; c++) {
+        cols[c] = h.cols[c];
+        if (cols[c] == DAT0) strcpy(names[c], "foF2");
+        else if (cols[c] == DAT1) strcpy(names[c], "hmF2");
+        else sprintf(names[c], "d[%d]", cols[c]);
+    }
+
+    struct temporal_reader rd;
+    if (temporalReaderOpen(&rd, argv[1], cols, h.ncols) != 0) {
+        fprintf(stderr, "Cannot read file ");
+        perror(argv[1]);
+        medianOnlineFree(&mo);
+        return 1;
+    }
+    rd.whole_lines = !flush;                            // a line being written is read next run
+    if (loaded && temporalReaderSeek(&rd, (long)h.offset) != 0) {
+        fprintf(stderr, "%s is shorter than at the last run\n", argv[1]);
+        temporalReaderClose(&rd);
+        medianOnlineFree(&mo);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (out_path) {
+        out = fopen(out_path, "a");
+        if (!out) {
+            fprintf(stderr, "Cannot open output ");
+            perror(out_path);
+            temporalReaderClose(&rd);
+            medianOnlineFree(&mo);
+            return 1;
+        }
+    }
+    fseek(out, 0, SEEK_END);
+    if (!loaded && ftell(out) <= 0)
+        fprintf(out, "channel,index,unfiltered,filtered\n");
+
+    struct temporal_chunk *chunk = malloc(sizeof(struct temporal_chunk));
+    struct median_sample *s = malloc((size_t)(slack + width + 1) * sizeof(struct median_sample));
+    int status = (chunk && s) ? 0 : -1;
+    long rows = 0, given = 0, late0 = mo.late;
+    float val[FLOAT_DATA];
+    int n = 0;
+    while (status == 0 && (n = temporalReaderRead(&rd, chunk)) > 0) {
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < h.ncols; c++)
+                val[c] = chunk->col[c][r];
+            int k = medianOnlinePush(&mo, chunk->key[r], val, s);
+            if (k > 0) {
+                writeSamples(out, names, h.ncols, s, k);
+                given += k;
+            }
+        }
+        rows += n;
+    }
+    if (n < 0)
+        status = 1;                                     // no state: the rows are read again
+    if (status == 0 && flush) {
+        int k = medianOnlineFlush(&mo, s);
+        writeSamples(out, names, h.ncols, s, k);
+        given += k;
+    }
+    h.offset = temporalReaderTell(&rd);
+    temporalReaderClose(&rd);
+
+    // the output first: a state is never ahead of what was written
+    if (fflush(out) != 0 || ferror(out))
+        status = -1;
+    if (out != stdout && fclose(out) != 0)
+        status = -1;
+    if (status < 0)
+        fprintf(stderr, "out of memory or cannot write output\n");
+    else if (status > 0)
+        fprintf(stderr, "%s: truncated or corrupt after row %ld\n", argv[1], (long)h.offset);
+    else if (flush)
+        remove(state_path);
+    else if (saveState(state_path, &h, &mo) != 0) {
+        fprintf(stderr, "cannot write state %s\n", state_path);
+        status = -1;
+    }
+
+    fprintf(stderr, "%ld rows read, %ld given out, %ld late and dropped, %d held back, %ld in the series\n",
+            rows, given, mo.late - late0, mo.npend, mo.pushed);
+
+    free(chunk);
+    free(s);
+    medianOnlineFree(&mo);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+/*
+    Program: online median filter, see median_online.h
+
+             The windows are the median_window heaps of median_engine.c,
+             one per channel over the samples in key order; widths 3 and
+             5 take the median from the sample ring with median3/median5
+             as medianFilterChannels does, so every value is the one of
+             the batch filter, bit for bit.
+
+             For an even width the batch filter leaves sample end - edge
+             unfiltered although its window is complete, so a sample is
+             only given out filtered once one more sample has come.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "median_online.h"
+
+#define ONLINE_ORDER 0x01020304
+
+// header of a saved state, the held back and the ring samples follow
+struct online_head
+{
+    char magic[8];
+    int32_t order;              // 0x01020304 as written, byte order check
+    int32_t width, slack, nch;
+    int32_t npend;
+    int64_t pushed, emitted, late;
+    int64_t last_key;
+};
+
+/*
+Function: medianOnlineInit
+          empty state of a station of nch channels, window width (1 for no
+          filtering), up to slack samples held back for reordering
+
+return: int , 0 on success, -1 on bad sizes or allocation failure
+*/
+int medianOnlineInit(struct median_online *mo, int width, int slack, int nch) {
+    memset(mo, 0, sizeof(*mo));
+    if (width < 1 || slack < 0 || nch < 1 || nch > ONLINE_MAX_CH)
+        return -1;
+    mo->width = width;
+    mo->edge = width / 2;
+    mo->slack = slack;
+    mo->nch = nch;
+    mo->pkey = malloc((slack + 1) * sizeof(int64_t));
+    mo->pval = malloc((size_t)(slack + 1) * nch * sizeof(float));
+    mo->hkey = malloc(width * sizeof(int64_t));
+    mo->hval = malloc((size_t)width * nch * sizeof(float));
+    int status = (mo->pkey && mo->pval && mo->hkey && mo->hval) ? 0 : -1;
+    for (int ch = 0; status == 0 && width >= 2 && ch < nch; ch++) {
+        if (medianWindowInit(&mo->mw[ch], width) != 0) {
+            while (ch-- > 0)
+                medianWindowFree(&mo->mw[ch]);
+            status = -1;
+        }
+    }
+    if (status != 0) {
+        free(mo->pkey);
+        free(mo->pval);
+        free(mo->hkey);
+        free(mo->hval);
+        memset(mo, 0, sizeof(*mo));
+    }
+    return status;
+}
+
+/*
+Function: medianOnlineFree
+
+return: void
+*/
+void medianOnlineFree(struct median_online *mo) {
+    for (int ch = 0; mo->width >= 2 && ch < mo->nch; ch++)
+        medianWindowFree(&mo->mw[ch]);
+    free(mo->pkey);
+    free(mo->pval);
+    free(mo->hkey);
+    free(mo->hval);
+    memset(mo, 0, sizeof(*mo));
+}
+
+static const float *ringVal(const struct median_online *mo, long i) {
+    return mo->hval + (size_t)(i % mo->width) * mo->nch;
+}
+
+/*
+Function: emitSample
+          sample i (still in the ring) into out, filtered with the window
+          starting at i - edge or unfiltered
+
+return: void
+*/
+static void emitSample(struct median_online *mo, long i, int filtered, struct median_sample *out) {
+    out->index = i;
+    out->key = mo->hkey[i % mo->width];
+    for (int ch = 0; ch < mo->nch; ch++) {
+        float v = ringVal(mo, i)[ch];
+        out->val[ch] = v;
+        if (!filtered) {
+            out->ftr[ch] = v;
+        } else if (mo->width == 3) {
+            out->ftr[ch] = median3(ringVal(mo, i - 1)[ch], v, ringVal(mo, i + 1)[ch]);
+        } else if (mo->width == 5) {
+            out->ftr[ch] = median5(ringVal(mo, i - 2)[ch], ringVal(mo, i - 1)[ch], v, ringVal(mo, i + 1)[ch],
+                                   ringVal(mo, i + 2)[ch]);
+        } else {
+            out->ftr[ch] = medianWindowValue(&mo->mw[ch]);
+        }
+    }
+    mo->emitted = i + 1;
+}
+
+/*
+Function: commitSample
+          a sample into the ring and the windows, giving out the samples
+          that are complete with it
+
+return: int , samples given out (0 or 1)
+*/
+static int commitSample(struct median_online *mo, int64_t key, const float val[], struct median_sample out[]) {
+    long j = mo->pushed;
+    int n = 0, even = (mo->width % 2 == 0);
+    int full = (mo->width >= 2 && mo->mw[0].count == mo->width);
+
+    if (even && full)                                   // the window ending at j - 1, now not the last
+        emitSample(mo, j - mo->width + mo->edge, 1, &out[n++]);
+
+    mo->hkey[j % mo->width] = key;
+    memcpy(mo->hval + (size_t)(j % mo->width) * mo->nch, val, mo->nch * sizeof(float));
+    for (int ch = 0; mo->width >= 2 && ch < mo->nch; ch++)
+        medianWindowPush(&mo->mw[ch], val[ch]);
+    mo->pushed = j + 1;
+    mo->last_key = key;
+
+    if (j < mo->edge || mo->width < 2)
+        emitSample(mo, j, 0, &out[n++]);
+    else if (!even && mo->mw[0].count == mo->width)
+        emitSample(mo, j - mo->width + 1 + mo->edge, 1, &out[n++]);
+    return n;
+}
+
+/*
+Function: medianOnlinePush
+          a new sample of the station: key and nch channel values; it is
+          held back with the others, the oldest goes into the windows
+          when more than slack are held
+          out: room for 1 sample
+
+return: int , samples given out, -1 if the sample came too late (dropped)
+*/
+int medianOnlinePush(struct median_online *mo, int64_t key, const float val[], struct median_sample out[]) {
+    if (mo->pushed > 0 && key < mo->last_key) {
+        mo->late++;
+        return -1;
+    }
+    int at = mo->npend;
+    while (at > 0 && mo->pkey[at - 1] > key)
+        at--;
+    memmove(mo->pkey + at + 1, mo->pkey + at, (mo->npend - at) * sizeof(int64_t));
+    memmove(mo->pval + (size_t)(at + 1) * mo->nch, mo->pval + (size_t)at * mo->nch,
+            (size_t)(mo->npend - at) * mo->nch * sizeof(float));
+    mo->pkey[at] = key;
+    memcpy(mo->pval + (size_t)at * mo->nch, val, mo->nch * sizeof(float));
+    mo->npend++;
+
+    if (mo->npend <= mo->slack)
+        return 0;
+    int n = commitSample(mo, mo->pkey[0], mo->pval, out);
+    mo->npend--;
+    memmove(mo->pkey, mo->pkey + 1, mo->npend * sizeof(int64_t));
+    memmove(mo->pval, mo->pval + mo->nch, (size_t)mo->npend * mo->nch * sizeof(float));
+    return n;
+}
+
+/*
+Function: medianOnlineFlush
+          end of the feed: the held back samples go into the windows and
+          the last ones are given out, unfiltered as the batch filter
+          leaves the end of the series; no sample may follow
+          out: room for slack + width samples
+
+return: int , samples given out
+*/
+int medianOnlineFlush(struct median_online *mo, struct median_sample out[]) {
+    int n = 0;
+    for (int p = 0; p < mo->npend; p++)
+        n += commitSample(mo, mo->pkey[p], mo->pval + (size_t)p * mo->nch, out + n);
+    mo->npend = 0;
+    for (long i = mo->emitted; i < mo->pushed; i++)
+        emitSample(mo, i, 0, &out[n++]);
+    return n;
+}
+
+/*
+Function: medianOnlineSave
+          the state to fp: counters, held back samples, the ring
+
+return: int , 0 on success, -1 on write error
+*/
+int medianOnlineSave(const struct median_online *mo, FILE *fp) {
+    struct online_head h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ONLINE_MAGIC, sizeof(h.magic));
+    h.order = ONLINE_ORDER;
+    h.width = mo->width;
+    h.slack = mo->slack;
+    h.nch = mo->nch;
+    h.npend = mo->npend;
+    h.pushed = mo->pushed;
+    h.emitted = mo->emitted;
+    h.late = mo->late;
+    h.last_key = mo->last_key;
+    fwrite(&h, sizeof(h), 1, fp);
+    for (int p = 0; p < mo->npend; p++) {
+        fwrite(&mo->pkey[p], sizeof(int64_t), 1, fp);
+        fwrite(mo->pval + (size_t)p * mo->nch, sizeof(float), mo->nch, fp);
+    }
+    long first = (mo->pushed > mo->width) ? mo->pushed - mo->width : 0;
+    for (long i = first; i < mo->pushed; i++) {
+        fwrite(&mo->hkey[i % mo->width], sizeof(int64_t), 1, fp);
+        fwrite(ringVal(mo, i), sizeof(float), mo->nch, fp);
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+/*
+Function: medianOnlineLoad
+          a state saved by medianOnlineSave: the ring samples are pushed
+          into fresh windows, nothing before them is needed
+
+return: int , 0 on success, -1 if fp holds no valid state
+*/
+int medianOnlineLoad(struct median_online *mo, FILE *fp) {
+    struct online_head h;
+    memset(mo, 0, sizeof(*mo));
+    if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, ONLINE_MAGIC, sizeof(h.magic)) != 0
+        || h.order != ONLINE_ORDER || h.npend < 0 || h.npend > h.slack || h.pushed < 0
+        || h.emitted > h.pushed || h.emitted < h.pushed - h.width)
+        return -1;
+    if (medianOnlineInit(mo, h.width, h.slack, h.nch) != 0)
+        return -1;
+
+    int ok = 1;
+    for (int p = 0; ok && p < h.npend; p++) {
+        ok = fread(&mo->pkey[p], sizeof(int64_t), 1, fp) == 1
+             && fread(mo->pval + (size_t)p * mo->nch, sizeof(float), mo->nch, fp) == (size_t)mo->nch;
+    }
+    long first = (h.pushed > h.width) ? (long)h.pushed - h.width : 0;
+    for (long i = first; ok && i < h.pushed; i++) {
+        float *v = mo->hval + (size_t)(i % mo->width) * mo->nch;
+        ok = fread(&mo->hkey[i % mo->width], sizeof(int64_t), 1, fp) == 1
+             && fread(v, sizeof(float), mo->nch, fp) == (size_t)mo->nch;
+        for (int ch = 0; ok && mo->width >= 2 && ch < mo->nch; ch++)
+            medianWindowPush(&mo->mw[ch], v[ch]);
+    }
+    if (!ok) {
+        medianOnlineFree(mo);
+        return -1;
+    }
+    mo->npend = h.npend;
+    mo->pushed = (long)h.pushed;
+    mo->emitted = (long)h.emitted;
+    mo->late = (long)h.late;
+    mo->last_key = h.last_key;
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+    Online median filter for a live feed: the window state of one station
+    (all its channels) is kept between samples and between runs, so a new
+    sweep is filtered without reading, sorting or filtering the history
+    again.
+
+    Samples come in with their date/time key (temporal_reader.h), in
+    order or slightly out of order: up to slack samples are held back and
+    put in key order before they enter the windows (ties keep their
+    arrival order, as the stable sort of the series).  A sample older
+    than one already in the windows is too late, it is dropped and
+    counted.
+
+    Sample i is given out as soon as its window is complete, edge
+    samples after it (half a window) plus the slack; the values are the
+    ones medianFilterChannels() gives for the sorted series: the first
+    and (at medianOnlineFlush) the last edge samples unfiltered, the
+    median of the window i - edge .. i - edge + width - 1 in between.
+
+    medianOnlineSave() writes the state (the last width samples, the
+    held back ones and the counters), medianOnlineLoad() restores it:
+    the windows are rebuilt from those samples alone.  (A rebuilt heap
+    window may pick the other of two equal values, which shows only as
+    the sign of a zero.)
+*/
+
+#ifndef MEDIAN_ONLINE_H
+#define MEDIAN_ONLINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "median_engine.h"
+
+#define ONLINE_MAX_CH 16        // channels per station
+#define ONLINE_MAGIC "MEDONL1"  // 8 bytes with the null
+
+// a sample given out: unfiltered and filtered value of each channel
+struct median_sample
+{
+    long index;                 // position in the sorted series of the station
+    int64_t key;
+    float val[ONLINE_MAX_CH];
+    float ftr[ONLINE_MAX_CH];
+};
+
+struct median_online
+{
+    int width;
+    int edge;
+    int slack;                  // samples held back for reordering
+    int nch;
+    long pushed;                // samples in the windows so far
+    long emitted;               // samples given out
+    long late;                  // samples dropped as too late
+    int64_t last_key;           // newest key in the windows
+    int npend;                  // held back samples, in key order
+    int64_t *pkey;
+    float *pval;                // [slack + 1][nch]
+    int64_t *hkey;              // the last width samples, ring by pushed % width
+    float *hval;                // [width][nch]
+    struct median_window mw[ONLINE_MAX_CH];
+};
+
+int medianOnlineInit(struct median_online *mo, int width, int slack, int nch);
+void medianOnlineFree(struct median_online *mo);
+int medianOnlinePush(struct median_online *mo, int64_t key, const float val[], struct median_sample out[]);
+int medianOnlineFlush(struct median_online *mo, struct median_sample out[]);
+int medianOnlineSave(const struct median_online *mo, FILE *fp);
+int medianOnlineLoad(struct median_online *mo, FILE *fp);
+
+#endif
@@ -0,0 +1,662 @@
+/*
+    Program: streaming reader for the temporal data file, see temporal_reader.h
+
+             The file is memory mapped and tokenized in place: fields are
+             found by scanning the mapped bytes, no line or field is copied,
+             and only the kept d[] columns are converted to float.
+             Where the file cannot be mapped (pipes, _WIN32) the same parser
+             runs over a block buffer refilled with fread.
+             Column files (iricol.h) are not parsed: the chunks are copied
+             (or decoded) from the mapped columns.
+
+             The header and blank line (known from inspection) are discarded,
+             the rest are data rows.  Rows with missing fields are skipped
+             and counted instead of reading past the end of the line.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "temporal_reader.h"
+#include "iricol.h"
+
+#define FIELD_LEN 64            // longest float field handed to the atof fallback
+#define ROW_FIELDS (4 + FLOAT_DATA)
+#define RELEASE_BYTES (8L << 20)   // parsed bytes of the mapping given back at a time
+
+// exact powers of ten for the fast float path
+static const double pow10tab[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+Function: mapFile
+          map the whole file read only, sequential access
+
+return: int , 0 on success, -1 if the file cannot be mapped
+*/
+static int mapFile(struct temporal_reader *rd, const char *filename) {
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                                          // the mapping stays valid
+    if (m == MAP_FAILED)
+        return -1;
+    madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    rd->map = m;
+    rd->map_len = (size_t)st.st_size;
+    rd->cur = rd->map;
+    rd->lim = rd->map + rd->map_len;
+    rd->eof = 1;                                        // everything is in view
+    return 0;
+#else
+    (void)rd; (void)filename;
+    return -1;
+#endif
+}
+
+/*
+Function: refill
+          fallback stream only: keep the unparsed tail, read the next block
+          the buffer doubles when a single line does not fit
+
+return: int , 1 if more bytes are in view, 0 at end of file
+*/
+static int refill(struct temporal_reader *rd) {
+    if (rd->eof)
+        return 0;
+    size_t keep = (size_t)(rd->lim - rd->cur);
+    if (keep == rd->cap) {
+        size_t cap = rd->cap ? 2 * rd->cap : 16 * READ_BUF;
+        char *b = malloc(cap);
+        if (!b) {
+            rd->eof = 1;
+            return 0;
+        }
+        memcpy(b, rd->cur, keep);
+        free(rd->buf);
+        rd->buf = b;
+        rd->cap = cap;
+    } else {
+        memmove(rd->buf, rd->cur, keep);
+    }
+    size_t got = fread(rd->buf + keep, 1, rd->cap - keep, rd->p);
+    if (got == 0)
+        rd->eof = 1;
+    rd->cur = rd->buf;
+    rd->lim = rd->buf + keep + got;
+    return got > 0;
+}
+
+/*
+Function: nextLine
+          bounds of the next line in view, without the newline
+
+return: int , 1 if a line was found, 0 at end of file
+*/
+static int nextLine(struct temporal_reader *rd, const char **b, const char **e) {
+    for (;;) {
+        const char *nl = memchr(rd->cur, '\n', (size_t)(rd->lim - rd->cur));
+        if (nl) {
+            *b = rd->cur; *e = nl;
+            rd->cur = nl + 1;
+            rd->line++;
+            return 1;
+        }
+        if (!refill(rd)) {
+            if (rd->cur == rd->lim || rd->whole_lines)
+                return 0;
+            *b = rd->cur; *e = rd->lim;                 // last line without newline
+            rd->cur = rd->lim;
+            rd->line++;
+            return 1;
+        }
+    }
+}
+
+static int64_t daysFromCivil(int y, int m, int d);
+
+/*
+Function: openColumns
+          a column file: d[c] is the c-th ICOL_VALUE column, the key
+          columns by name
+
+return: int , 0 on success, -1 if it cannot be read or has too few
+        value columns
+*/
+static int openColumns(struct temporal_reader *rd, const char *filename) {
+    static const char *const key[3] = { "year", "mmdd", "hour" };
+    rd->colf = malloc(sizeof(*rd->colf));
+    if (!rd->colf || iriColOpen(rd->colf, filename) != 0) {
+        free(rd->colf);
+        rd->colf = NULL;
+        return -1;
+    }
+    const struct iri_colr *r = rd->colf;
+    int value[FLOAT_DATA], nvalue = 0;
+    for (int c = 0; c < r->head->ncols && nvalue < FLOAT_DATA; c++) {
+        if (r->def[c].kind == ICOL_VALUE)
+            value[nvalue++] = c;
+    }
+    int ok = 1;
+    for (int c = 0; c < rd->ncols; c++) {
+        ok = ok && rd->cols[c] < nvalue;
+        rd->col_at[c] = ok ? value[rd->cols[c]] : -1;
+    }
+    for (int k = 0; k < 3; k++)
+        rd->col_key[k] = iriColFind(r, key[k]);
+    if (!ok) {
+        fprintf(stderr, "%s: %d value columns\n", filename, nvalue);
+        temporalReaderClose(rd);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Function: readColumns
+          next chunk of a column file, int32 columns as float; the key of
+          year, mmdd (or day of year if negative) and hour (LT, or UT + 25)
+
+return: int , number of rows in the chunk, 0 at end of file, -1 if the
+        columns cannot be read (truncated or corrupt file)
+*/
+static int readColumns(struct temporal_reader *rd, struct temporal_chunk *chunk) {
+    const struct iri_colr *r = rd->colf;
+    long left = (long)r->head->rows - rd->col_row;
+    int n = (left < READ_CHUNK) ? (int)left : READ_CHUNK;
+    int32_t iv[READ_CHUNK];
+    float fv[READ_CHUNK];
+
+    chunk->rows = 0;
+    for (int c = 0; c < rd->ncols; c++) {
+        int at = rd->col_at[c];
+        if (iriColRead(r, at, rd->col_row, n, (r->def[at].type == ICOL_F32) ? (void *)chunk->col[c] : iv) != 0)
+            return -1;
+        for (int i = 0; r->def[at].type == ICOL_I32 && i < n; i++)
+            chunk->col[c][i] = (float)iv[i];
+    }
+
+    for (int i = 0; i < n; i++)
+        chunk->key[i] = rd->col_row + i;
+    if (rd->col_key[0] >= 0 && rd->col_key[1] >= 0 && rd->col_key[2] >= 0) {
+        int32_t yy[READ_CHUNK];
+        if (iriColRead(r, rd->col_key[0], rd->col_row, n, yy) != 0
+            || iriColRead(r, rd->col_key[1], rd->col_row, n, iv) != 0
+            || iriColRead(r, rd->col_key[2], rd->col_row, n, fv) != 0)
+            return -1;
+        for (int i = 0; i < n; i++) {
+            int64_t day = (iv[i] < 0) ? daysFromCivil(yy[i], 1, 1) - iv[i] - 1
+                                      : daysFromCivil(yy[i], iv[i] / 100, iv[i] % 100);
+            float h = (fv[i] >= 25.f) ? fv[i] - 25.f : fv[i];
+            chunk->key[i] = day * 86400 + (int64_t)(h * 3600.f + 0.5f);
+        }
+    }
+    rd->col_row += n;
+    chunk->rows = n;
+    return n;
+}
+
+/*
+Function: temporalReaderOpen
+          open the input file and discard the header and blank line
+          cols[]: d[] indices to keep, in the order they are stored
+
+return: int , 0 on success, -1 if the file cannot be read
+*/
+int temporalReaderOpen(struct temporal_reader *rd, const char *filename, const int cols[], int ncols) {
+    memset(rd, 0, sizeof(*rd));
+    if (ncols < 0 || ncols > FLOAT_DATA)
+        return -1;
+    for (int c = 0; c < ncols; c++) {
+        if (cols[c] < 0 || cols[c] >= FLOAT_DATA)
+            return -1;
+        rd->cols[c] = cols[c];
+    }
+    rd->ncols = ncols;
+
+    if (iriColIsFile(filename))
+        return openColumns(rd, filename);
+    if (mapFile(rd, filename) != 0) {
+        rd->p = fopen(filename, "rb");
+        if (!rd->p)
+            return -1;
+    }
+
+    // upon inspection, input file has header then blank row
+    // discard both
+    // does not account missing header so it will treat a line as any other
+    const char *b, *e;
+    nextLine(rd, &b, &e);
+    nextLine(rd, &b, &e);
+
+    return 0;
+}
+
+/*
+Function: fieldFloat
+          convert one field in place, same value as atof() cast to float
+          plain decimals of up to 19 digits are converted exactly from an
+          integer mantissa and a power of ten, anything else goes to atof
+
+return: float
+*/
+static float fieldFloat(const char *b, const char *e) {
+    const char *s = b;
+    int neg = 0;
+    if (s < e && (*s == '-' || *s == '+'))
+        neg = (*s++ == '-');
+
+    unsigned long long m = 0;
+    int digits = 0, scale = 0;
+    while (s < e && *s >= '0' && *s <= '9') {
+        m = m * 10 + (unsigned)(*s++ - '0');
+        digits++;
+    }
+    if (s < e && *s == '.') {
+        s++;
+        while (s < e && *s >= '0' && *s <= '9') {
+            m = m * 10 + (unsigned)(*s++ - '0');
+            digits++; scale--;
+        }
+    }
+    if (digits > 0 && s < e && (*s == 'e' || *s == 'E')) {
+        const char *x = s + 1;
+        int eneg = 0, ex = 0, exd = 0;
+        if (x < e && (*x == '-' || *x == '+'))
+            eneg = (*x++ == '-');
+        while (x < e && *x >= '0' && *x <= '9' && exd < 6) {
+            ex = ex * 10 + (*x++ - '0');
+            exd++;
+        }
+        if (exd > 0) {
+            scale += eneg ? -ex : ex;
+            s = x;
+        }
+    }
+
+    if (s == e && digits > 0 && digits <= 19 && m < (1ULL << 53)
+            && scale >= -22 && scale <= 22) {
+        double d = (double)m;
+        d = (scale < 0) ? d / pow10tab[-scale] : d * pow10tab[scale];
+        return (float)(neg ? -d : d);
+    }
+
+    // not a plain decimal (nan, ---, very long): atof on a terminated copy
+    char tmp[FIELD_LEN];
+    size_t n = (size_t)(e - b);
+    if (n >= FIELD_LEN) n = FIELD_LEN - 1;
+    memcpy(tmp, b, n);
+    tmp[n] = '\0';
+    return atof(tmp);
+}
+
+/*
+Function: fieldInts
+          up to 3 unsigned integers separated by single non-digits,
+          e.g. 2021.03.03 or 11:00:00 (seconds optional, fraction ignored)
+
+return: int , number of integers found, 0 if the field is malformed
+*/
+static int fieldInts(const char *b, const char *e, int v[3]) {
+    int n = 0;
+    const char *s = b;
+    v[0] = v[1] = v[2] = 0;
+    while (n < 3 && s < e) {
+        if (*s < '0' || *s > '9')
+            return 0;
+        int x = 0;
+        while (s < e && *s >= '0' && *s <= '9' && x < 100000)
+            x = x * 10 + (*s++ - '0');
+        v[n++] = x;
+        if (s < e) s++;                                 // separator
+    }
+    return n;
+}
+
+/*
+Function: daysFromCivil
+          days since 1970-01-01 of a proleptic Gregorian date
+          based on: http://howardhinnant.github.io/date_algorithms.html
+
+return: int64_t
+*/
+static int64_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = (int)(y - era * 400);
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/*
+Function: parseRow
+          split one data row in place, convert only the kept columns
+
+return: int , 1 if the row was complete, 0 otherwise
+*/
+static int parseRow(struct temporal_reader *rd, const char *b, const char *e, struct temporal_chunk *chunk, int r) {
+    const char *fb[ROW_FIELDS], *fe[ROW_FIELDS];
+    int n = 0;
+    const char *s = b;
+    while (n < ROW_FIELDS) {
+        while (s < e && (*s == ' ' || *s == '\t' || *s == '\r')) s++;
+        if (s == e) break;
+        fb[n] = s;
+        while (s < e && *s != ' ' && *s != '\t' && *s != '\r') s++;
+        fe[n++] = s;
+    }
+    if (n < ROW_FIELDS)
+        return 0;
+
+    // date and time become a single integer key for sorting
+    int ymd[3], hms[3];
+    if (fieldInts(fb[0], fe[0], ymd) != 3 || fieldInts(fb[2], fe[2], hms) < 2)
+        return 0;
+    if (ymd[1] < 1 || ymd[1] > 12 || ymd[2] < 1 || ymd[2] > 31)
+        return 0;
+    chunk->key[r] = (daysFromCivil(ymd[0], ymd[1], ymd[2]) * 24 + hms[0]) * 3600
+                    + hms[1] * 60 + hms[2];
+
+    for (int c = 0; c < rd->ncols; c++) {
+        int k = 4 + rd->cols[c];
+        chunk->col[c][r] = fieldFloat(fb[k], fe[k]);
+    }
+
+    return 1;
+}
+
+/*
+Function: temporalReaderRead
+          read the next chunk of up to READ_CHUNK rows
+
+return: int , number of rows in the chunk, 0 at end of file, -1 on a
+        column file that cannot be read (chunk->rows is 0)
+*/
+int temporalReaderRead(struct temporal_reader *rd, struct temporal_chunk *chunk) {
+    if (rd->colf)
+        return readColumns(rd, chunk);
+    const char *b, *e;
+    int r = 0;
+    while (r < READ_CHUNK && nextLine(rd, &b, &e)) {
+        const char *s = b;
+        while (s < e && (*s == ' ' || *s == '\t' || *s == '\r')) s++;
+        if (s == e)
+            continue;                                   // blank line
+        if (parseRow(rd, b, e, chunk, r))
+            r++;
+        else
+            rd->skipped++;
+    }
+    chunk->rows = r;
+#ifndef _WIN32
+    // the parsed pages are not read again: drop them, so a file streamed
+    // chunk by chunk holds a window of the mapping, not all of it
+    if (rd->map) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t upto = (size_t)(rd->cur - rd->map) / page * page;
+        if (upto - rd->released >= RELEASE_BYTES) {
+            madvise((void *)(rd->map + rd->released), upto - rd->released, MADV_DONTNEED);
+            rd->released = upto;
+        }
+    }
+#endif
+    return r;
+}
+
+/*
+Function: temporalReaderTell
+          position of the next row: byte offset in a data file, row in a
+          column file; a row read later starts there
+
+return: long , position, -1 on error
+*/
+long temporalReaderTell(const struct temporal_reader *rd) {
+    if (rd->colf)
+        return rd->col_row;
+    if (rd->map)
+        return (long)(rd->cur - rd->map);
+    long at = ftell(rd->p);
+    return (at < 0) ? -1 : at - (long)(rd->lim - rd->cur);
+}
+
+/*
+Function: temporalReaderSeek
+          go on reading at a position from temporalReaderTell, of this or
+          of an earlier open of the same (grown) file
+
+return: int , 0 on success, -1 if the position is not in the file
+*/
+int temporalReaderSeek(struct temporal_reader *rd, long pos) {
+    if (pos < 0)
+        return -1;
+    if (rd->colf) {
+        if (pos > rd->colf->head->rows)
+            return -1;
+        rd->col_row = pos;
+        return 0;
+    }
+    if (rd->map) {
+        if ((size_t)pos > rd->map_len)
+            return -1;
+        rd->cur = rd->map + pos;
+#ifndef _WIN32
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        if ((size_t)pos / page * page > rd->released)
+            rd->released = (size_t)pos / page * page;   // skipped pages are never touched
+#endif
+        return 0;
+    }
+    if (fseek(rd->p, pos, SEEK_SET) != 0)
+        return -1;
+    rd->cur = rd->lim = rd->buf;
+    rd->eof = 0;
+    return 0;
+}
+
+/*
+Function: temporalReaderClose
+
+return: void
+*/
+void temporalReaderClose(struct temporal_reader *rd) {
+#ifndef _WIN32
+    if (rd->map)
+        munmap((void *)rd->map, rd->map_len);
+#endif
+    if (rd->p)
+        fclose(rd->p);
+    free(rd->buf);
+    if (rd->colf) {
+        iriColClose(rd->colf);
+        free(rd->colf);
+    }
+    rd->colf = NULL;
+    rd->map = NULL;
+    rd->p = NULL;
+    rd->buf = NULL;
+}
+
+/*
+Function: temporalSeriesInit
+          empty series holding ncols float columns
+
+return: void
+*/
+void temporalSeriesInit(struct temporal_series *ts, int ncols) {
+    memset(ts, 0, sizeof(*ts));
+    ts->ncols = ncols;
+}
+
+/*
+Function: temporalSeriesAppend
+          append a chunk, the arrays grow geometrically so the whole file
+          is read in one pass without knowing the row count
+
+return: int , 0 on success, -1 on allocation failure
+*/
+int temporalSeriesAppend(struct temporal_series *ts, const struct temporal_chunk *chunk) {
+    int need = ts->rows + chunk->rows;
+    if (need > ts->cap) {
+        int cap = ts->cap ? ts->cap : READ_CHUNK;
+        while (cap < need)
+            cap *= 2;
+        int64_t *k = realloc(ts->key, (size_t)cap * sizeof(int64_t));
+        if (!k)
+            return -1;
+        ts->key = k;
+        for (int c = 0; c < ts->ncols; c++) {
+            float *f = realloc(ts->col[c], (size_t)cap * sizeof(float));
+            if (!f)
+                return -1;
+            ts->col[c] = f;
+        }
+        ts->cap = cap;
+    }
+
+    memcpy(ts->key + ts->rows, chunk->key, (size_t)chunk->rows * sizeof(int64_t));
+    for (int c = 0; c < ts->ncols; c++)
+        memcpy(ts->col[c] + ts->rows, chunk->col[c], (size_t)chunk->rows * sizeof(float));
+    ts->rows = need;
+
+    return 0;
+}
+
+/*
+Function: temporalSeriesFree
+
+return: void
+*/
+void temporalSeriesFree(struct temporal_series *ts) {
+    free(ts->key);
+    for (int c = 0; c < ts->ncols; c++)
+        free(ts->col[c]);
+    memset(ts, 0, sizeof(*ts));
+}
+
+/*
+Function: temporalSeriesSort
+          put the rows in key (date/time) order, rows with equal keys keep
+          their file order
+          already ordered input (the usual case) is detected and left as is,
+          otherwise LSD radix sort of (key, row) pairs, 8 bits per pass,
+          passes where every key has the same byte are skipped,
+          then each column is gathered once in the new order
+
+return: int , 0 on success, -1 on allocation failure
+*/
+int temporalSeriesSort(struct temporal_series *ts) {
+    int n = ts->rows;
+    int k = 1;
+    while (k < n && ts->key[k - 1] <= ts->key[k])
+        k++;
+    if (k >= n)
+        return 0;                                       // monotonic, no sort
+
+    uint64_t *ukey = malloc((size_t)n * sizeof(uint64_t));
+    uint64_t *ukey2 = malloc((size_t)n * sizeof(uint64_t));
+    int *row = malloc((size_t)n * sizeof(int));
+    int *row2 = malloc((size_t)n * sizeof(int));
+    float *tmp = malloc((size_t)n * sizeof(float));
+    if (!ukey || !ukey2 || !row || !row2 || !tmp) {
+        free(ukey); free(ukey2); free(row); free(row2); free(tmp);
+        return -1;
+    }
+
+    // flip the sign bit so signed keys sort as unsigned
+    for (int i = 0; i < n; i++) {
+        ukey[i] = (uint64_t)ts->key[i] ^ 0x8000000000000000ULL;
+        row[i] = i;
+    }
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        int count[257] = { 0 };
+        for (int i = 0; i < n; i++)
+            count[((ukey[i] >> shift) & 0xff) + 1]++;
+        if (count[((ukey[0] >> shift) & 0xff) + 1] == n)
+            continue;                                   // same byte everywhere
+        for (int b = 0; b < 256; b++)
+            count[b + 1] += count[b];
+        for (int i = 0; i < n; i++) {
+            int d = count[(ukey[i] >> shift) & 0xff]++;
+            ukey2[d] = ukey[i];
+            row2[d] = row[i];
+        }
+        uint64_t *tk = ukey; ukey = ukey2; ukey2 = tk;
+        int *tr = row; row = row2; row2 = tr;
+    }
+
+    for (int i = 0; i < n; i++)
+        ts->key[i] = (int64_t)(ukey[i] ^ 0x8000000000000000ULL);
+    for (int c = 0; c < ts->ncols; c++) {
+        for (int i = 0; i < n; i++)
+            tmp[i] = ts->col[c][row[i]];
+        memcpy(ts->col[c], tmp, (size_t)n * sizeof(float));
+    }
+
+    free(ukey); free(ukey2); free(row); free(row2); free(tmp);
+    return 0;
+}
+
+/*
+Function: temporalReadSeries
+          read a whole file into a series, chunk by chunk
+
+return: int , number of rows, -1 if the file cannot be read (also part of
+        it) or memory runs out
+*/
+int temporalReadSeries(struct temporal_series *ts, const char *filename, const int cols[], int ncols) {
+    struct temporal_reader rd;
+    if (temporalReaderOpen(&rd, filename, cols, ncols) != 0)
+        return -1;
+
+    struct temporal_chunk *chunk = malloc(sizeof(*chunk));
+    if (!chunk) {
+        temporalReaderClose(&rd);
+        return -1;
+    }
+
+    temporalSeriesInit(ts, ncols);
+    int status = 0, n;
+    while ((n = temporalReaderRead(&rd, chunk)) > 0) {
+        if (temporalSeriesAppend(ts, chunk) != 0) {
+            status = -1;
+            break;
+        }
+    }
+    if (n < 0) {
+        fprintf(stderr, "%s: truncated or corrupt after row %ld\n", filename, rd.col_row);
+        errno = EIO;                                    // for the caller's perror
+        status = -1;
+    }
+    if (rd.skipped > 0)
+        fprintf(stderr, "%s: %ld malformed rows skipped\n", filename, rd.skipped);
+
+    free(chunk);
+    temporalReaderClose(&rd);
+    if (status != 0) {
+        temporalSeriesFree(ts);
+        return -1;
+    }
+
+    return ts->rows;
+}
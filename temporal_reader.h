@@ -0,0 +1,90 @@
+/*
+    Streaming reader for the temporal (ionosonde) data file.
+
+    The file is read in one pass, a chunk of rows at a time, and only the
+    requested d[] columns are kept.  Fields are parsed in place from the
+    memory mapped file, without copying lines or fields.  No row count is needed in advance:
+    callers either consume the chunks as they come (bounded memory)
+    or append them to a growable series.
+
+    Input:   data file (header, blank row, data rows)
+             date dig time x d[0] .. d[FLOAT_DATA-1]
+             date as yyyy.mm.dd, time as hh:mm:ss (any single separator)
+
+    The date and time of a row are packed into one 64-bit key so the
+    rows can be put in time order with a radix sort.
+
+    A column file of the IRI sweeps (iri_edp/iricol.h, magic IRICOL1) is
+    read too, mapped: d[c] is its c-th value column, the key comes from
+    its year, mmdd and hour columns (as struct iri_time), or is the row
+    number if it has none.
+*/
+
+#ifndef TEMPORAL_READER_H
+#define TEMPORAL_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define FILE_NAME_LEN 256       // standard file name length
+#define FLOAT_DATA 11
+#define READ_BUF 1024           // read buffer size, default = 1024
+#define READ_CHUNK 4096         // rows handed out per chunk
+
+// one chunk of rows, only the selected columns
+struct temporal_chunk
+{
+    int rows;
+    int64_t key[READ_CHUNK];                    // date/time, seconds since 1970-01-01 UTC
+    float col[FLOAT_DATA][READ_CHUNK];          // col[c] holds d[cols[c]]
+};
+
+struct iri_colr;
+
+struct temporal_reader
+{
+    const char *map;            // mapped file, or NULL
+    size_t map_len;
+    size_t released;            // mapped bytes before this are parsed and given back
+    FILE *p;                    // fallback stream when the file cannot be mapped
+    char *buf;                  // fallback block buffer
+    size_t cap;
+    const char *cur;            // next unparsed byte
+    const char *lim;            // end of the bytes in view
+    int eof;                    // no more bytes beyond lim
+    int whole_lines;            // set: a last line without newline is not read (file still growing)
+    long line;                  // last line read, for messages
+    long skipped;               // malformed rows skipped
+    int ncols;
+    int cols[FLOAT_DATA];       // d[] index of each kept column
+    struct iri_colr *colf;      // column file, or NULL
+    long col_row;               // next row of the column file
+    int col_at[FLOAT_DATA];     // its column of each kept column
+    int col_key[3];             // its year, mmdd and hour columns, -1 if none
+};
+
+// all the rows of a file, struct of arrays grown as chunks are appended
+struct temporal_series
+{
+    int rows;
+    int cap;
+    int ncols;
+    int64_t *key;
+    float *col[FLOAT_DATA];
+};
+
+int temporalReaderOpen(struct temporal_reader *rd, const char *filename, const int cols[], int ncols);
+int temporalReaderRead(struct temporal_reader *rd, struct temporal_chunk *chunk);
+long temporalReaderTell(const struct temporal_reader *rd);
+int temporalReaderSeek(struct temporal_reader *rd, long pos);
+void temporalReaderClose(struct temporal_reader *rd);
+
+void temporalSeriesInit(struct temporal_series *ts, int ncols);
+int temporalSeriesAppend(struct temporal_series *ts, const struct temporal_chunk *chunk);
+void temporalSeriesFree(struct temporal_series *ts);
+
+int temporalSeriesSort(struct temporal_series *ts);
+
+int temporalReadSeries(struct temporal_series *ts, const char *filename, const int cols[], int ncols);
+
+#endif